@@ -0,0 +1,378 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition directly
+ * with the discrete sine transform.
+ *
+ */
+
+
+#include "PoissonDST2D.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/* Complex FFT of length n, the values interleaved as re, im. When n is not
+ * a power of 2 it is Bluestein's convolution, done with FFTs of length m. */
+typedef struct {
+	int n;
+	int m;         /* power of 2: n, or at least 2 n - 1 */
+	int *rev;      /* bit reversal permutation of m */
+	double *tw;    /* e^(-2 pi i k / m), k < m / 2 */
+	double *chirp; /* e^(-pi i k^2 / n), k < n, for Bluestein */
+	double *kern;  /* FFT of the conjugate chirp over m, for Bluestein */
+} DSTPlan;
+
+
+static int initPlan(DSTPlan *p, int n);
+static void freePlan(DSTPlan *p);
+static void fft(const DSTPlan *p, double *z);
+static void dft(const DSTPlan *p, double *z, double *tmp);
+static void dst2(const DSTPlan *p, double *a, double *b, size_t stride,
+                 int n, double *z, double *tmp);
+static void transform2D(const DSTPlan *p, double *u, int n, double *z,
+                        double *tmp);
+
+
+int PoissonDST2D(double *f, double (*g)(int, int, int), int N)
+{
+	double *rhs;
+	int ret;
+
+	if (NULL == f)
+		return 1;
+
+	if (!(rhs = allocGrid(N, 0))) {
+		perror("RHS array allocation error:");
+		return -1;
+	}
+
+	fillRHS(rhs, g, N);
+	ret = PoissonDST2DRHS(f, rhs, N, NULL);
+
+	free(rhs);
+	return ret;
+}
+
+
+/* With S the sine transform of size n = N - 2, S^2 = (N - 1) / 2. The
+ * second difference along x or y has the eigenvalues
+ * -4 sin^2(pi k / (2 (N - 1))), k = 1 .. n, on the columns of S, so
+ * f = (2 / (N - 1))^2 S S (S S b / (l_x + l_y)) on the interior, b the RHS
+ * less the boundary neighbors. transform2D() gives 4 S S, hence the factor
+ * 1 / (4 (N - 1)^2) below. */
+int PoissonDST2DRHS(double *f, const double *rhs, int N,
+                    const SOROptions *opts)
+{
+	DSTPlan plan;
+	struct timespec t0, t1;
+	double *u, *work, *eig;
+	const int n = N - 2;
+	const double M = N - 1.;
+	size_t zlen;
+	int k, nthreads = 1;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+	/* no interior points */
+	if (n < 1)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+	#endif
+	if (initPlan(&plan, 2 * (N - 1)))
+		return -1;
+	/* per thread: the extended row, and the Bluestein convolution */
+	zlen = 2 * (size_t) plan.n + ((plan.m != plan.n) ? 2 * (size_t) plan.m
+	                                                 : 0);
+	u = (double *) malloc((size_t) n * n * sizeof(double));
+	work = (double *) malloc(nthreads * zlen * sizeof(double));
+	eig = (double *) malloc(n * sizeof(double));
+	if ((NULL == u) || (NULL == work) || (NULL == eig)) {
+		perror("DST arrays allocation error:");
+		free(u);
+		free(work);
+		free(eig);
+		freePlan(&plan);
+		return -1;
+	}
+	for (k = 0; k < n; k++)
+		eig[k] = -4. * sin(M_PI * (k + 1) / (2. * M)) *
+		         sin(M_PI * (k + 1) / (2. * M));
+
+	#pragma omp parallel
+	{
+		int i, j, tid = 0;
+		double v, *z, *tmp;
+
+		#ifdef _OPENMP
+		tid = omp_get_thread_num();
+		#endif
+		z = work + tid * zlen;
+		tmp = z + 2 * plan.n;
+
+		#pragma omp for
+		for (j = 1; j <= n; j++)
+			for (i = 1; i <= n; i++) {
+				v = rhs[i + (size_t) j * N];
+				if (1 == i)
+					v -= f[(size_t) j * N];
+				if (n == i)
+					v -= f[N - 1 + (size_t) j * N];
+				if (1 == j)
+					v -= f[i];
+				if (n == j)
+					v -= f[i + (size_t) (N - 1) * N];
+				u[i - 1 + (size_t) (j - 1) * n] = v;
+			}
+
+		transform2D(&plan, u, n, z, tmp);
+
+		#pragma omp for
+		for (j = 0; j < n; j++)
+			for (i = 0; i < n; i++)
+				u[i + (size_t) j * n] /= 4. * M * M *
+				                         (eig[i] + eig[j]);
+
+		transform2D(&plan, u, n, z, tmp);
+
+		#pragma omp for
+		for (j = 1; j <= n; j++)
+			memcpy(f + 1 + (size_t) j * N, u + (size_t) (j - 1) * n,
+			       n * sizeof(double));
+	}
+
+	free(u);
+	free(work);
+	free(eig);
+	freePlan(&plan);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if ((NULL != opts) && (NULL != opts->stats)) {
+		opts->stats->sweeps = 0;
+		opts->stats->checks = 0;
+		opts->stats->interval = 0;
+		opts->stats->norm = 0.;
+		opts->stats->time = (t1.tv_sec - t0.tv_sec) +
+		                    (t1.tv_nsec - t0.tv_nsec) / 1.E9;
+	}
+
+	return 0;
+}
+
+
+static int initPlan(DSTPlan *p, int n)
+{
+	double a;
+	int i, k, bits = 0, m = 1;
+
+	memset(p, 0, sizeof(DSTPlan));
+	while (m < n)
+		m *= 2;
+	if (m != n)
+		while (m < 2 * n - 1)
+			m *= 2;
+	while ((1 << bits) < m)
+		bits++;
+	p->n = n;
+	p->m = m;
+
+	p->rev = (int *) malloc(m * sizeof(int));
+	p->tw = (double *) malloc(m * sizeof(double));
+	if (m != n) {
+		p->chirp = (double *) malloc(2 * n * sizeof(double));
+		p->kern = (double *) malloc(2 * m * sizeof(double));
+	}
+	if ((NULL == p->rev) || (NULL == p->tw) ||
+	    ((m != n) && ((NULL == p->chirp) || (NULL == p->kern)))) {
+		perror("FFT plan allocation error:");
+		freePlan(p);
+		return -1;
+	}
+
+	for (i = 0; i < m; i++) {
+		p->rev[i] = 0;
+		for (k = 0; k < bits; k++)
+			p->rev[i] |= ((i >> k) & 1) << (bits - 1 - k);
+	}
+	for (k = 0; k < m / 2; k++) {
+		p->tw[2 * k] = cos(2. * M_PI * k / m);
+		p->tw[2 * k + 1] = -sin(2. * M_PI * k / m);
+	}
+	if (m == n)
+		return 0;
+
+	/* k^2 modulo 2 n keeps the angle small and exact */
+	for (k = 0; k < n; k++) {
+		a = M_PI * (double) (((long long) k * k) % (2 * n)) / n;
+		p->chirp[2 * k] = cos(a);
+		p->chirp[2 * k + 1] = -sin(a);
+	}
+	memset(p->kern, 0, 2 * m * sizeof(double));
+	for (k = 0; k < n; k++) {
+		p->kern[2 * k] = p->chirp[2 * k];
+		p->kern[2 * k + 1] = -p->chirp[2 * k + 1];
+		if (k > 0) {
+			p->kern[2 * (m - k)] = p->kern[2 * k];
+			p->kern[2 * (m - k) + 1] = p->kern[2 * k + 1];
+		}
+	}
+	fft(p, p->kern);
+	/* with the 1 / m of the inverse FFT of the convolution */
+	for (k = 0; k < 2 * m; k++)
+		p->kern[k] /= m;
+
+	return 0;
+}
+
+
+static void freePlan(DSTPlan *p)
+{
+	free(p->rev);
+	free(p->tw);
+	free(p->chirp);
+	free(p->kern);
+	p->rev = NULL;
+	p->tw = p->chirp = p->kern = NULL;
+}
+
+
+/* Radix 2 FFT of length p->m in place, iterative after the bit reversal */
+static void fft(const DSTPlan *p, double *z)
+{
+	const int m = p->m;
+	int i, j, k, len, half, step;
+	double *a, *b, tr, ti, wr, wi;
+
+	for (i = 0; i < m; i++) {
+		j = p->rev[i];
+		if (i < j) {
+			tr = z[2 * i];
+			ti = z[2 * i + 1];
+			z[2 * i] = z[2 * j];
+			z[2 * i + 1] = z[2 * j + 1];
+			z[2 * j] = tr;
+			z[2 * j + 1] = ti;
+		}
+	}
+
+	for (len = 2; len <= m; len *= 2) {
+		half = len / 2;
+		step = m / len;
+		for (i = 0; i < m; i += len)
+			for (k = 0; k < half; k++) {
+				wr = p->tw[2 * k * step];
+				wi = p->tw[2 * k * step + 1];
+				a = z + 2 * (i + k);
+				b = a + 2 * half;
+				tr = wr * b[0] - wi * b[1];
+				ti = wr * b[1] + wi * b[0];
+				b[0] = a[0] - tr;
+				b[1] = a[1] - ti;
+				a[0] += tr;
+				a[1] += ti;
+			}
+	}
+}
+
+
+/* FFT of length p->n in place. tmp holds p->m values when p->n is not a
+ * power of 2: X_k = c_k sum_j (x_j c_j) conj(c_(k - j)), c_k the chirp,
+ * is a convolution, done with FFTs. */
+static void dft(const DSTPlan *p, double *z, double *tmp)
+{
+	const int n = p->n, m = p->m;
+	const double *c = p->chirp, *w = p->kern;
+	double re, im;
+	int k;
+
+	if (n == m) {
+		fft(p, z);
+		return;
+	}
+
+	for (k = 0; k < n; k++) {
+		tmp[2 * k] = z[2 * k] * c[2 * k] - z[2 * k + 1] * c[2 * k + 1];
+		tmp[2 * k + 1] = z[2 * k] * c[2 * k + 1] +
+		                 z[2 * k + 1] * c[2 * k];
+	}
+	memset(tmp + 2 * n, 0, 2 * (size_t) (m - n) * sizeof(double));
+	fft(p, tmp);
+
+	/* times the kernel and conjugated: the inverse FFT is the conjugate
+	 * of the FFT of the conjugate */
+	for (k = 0; k < m; k++) {
+		re = tmp[2 * k] * w[2 * k] - tmp[2 * k + 1] * w[2 * k + 1];
+		im = tmp[2 * k] * w[2 * k + 1] + tmp[2 * k + 1] * w[2 * k];
+		tmp[2 * k] = re;
+		tmp[2 * k + 1] = -im;
+	}
+	fft(p, tmp);
+
+	for (k = 0; k < n; k++) {
+		re = tmp[2 * k];
+		im = -tmp[2 * k + 1];
+		z[2 * k] = re * c[2 * k] - im * c[2 * k + 1];
+		z[2 * k + 1] = re * c[2 * k + 1] + im * c[2 * k];
+	}
+}
+
+
+/* Sine transform (DST-I) of the n values of a and of b, stride apart, in
+ * place, X_k = 2 sum_j x_j sin(pi j k / (n + 1)), j, k = 1 .. n. The odd
+ * extensions of a and b to 2 (n + 1) values, as the real and imaginary
+ * parts of z, have the FFT -i X_a + X_b. b may be NULL. */
+static void dst2(const DSTPlan *p, double *a, double *b, size_t stride,
+                 int n, double *z, double *tmp)
+{
+	const int L = p->n;
+	int j;
+
+	z[0] = z[1] = z[L] = z[L + 1] = 0.;
+	for (j = 1; j <= n; j++) {
+		z[2 * j] = a[(j - 1) * stride];
+		z[2 * j + 1] = b ? b[(j - 1) * stride] : 0.;
+		z[2 * (L - j)] = -z[2 * j];
+		z[2 * (L - j) + 1] = -z[2 * j + 1];
+	}
+
+	dft(p, z, tmp);
+
+	for (j = 1; j <= n; j++) {
+		a[(j - 1) * stride] = -z[2 * j + 1];
+		if (b)
+			b[(j - 1) * stride] = z[2 * j];
+	}
+}
+
+
+/* Sine transform of the n x n array u along x, then along y, two rows or
+ * columns at a time. Called by all the threads of a team. */
+static void transform2D(const DSTPlan *p, double *u, int n, double *z,
+                        double *tmp)
+{
+	int k;
+
+	#pragma omp for
+	for (k = 0; k < (n + 1) / 2; k++)
+		dst2(p, u + (size_t) 2 * k * n,
+		     (2 * k + 1 < n) ? u + (size_t) (2 * k + 1) * n : NULL, 1, n,
+		     z, tmp);
+
+	#pragma omp for
+	for (k = 0; k < (n + 1) / 2; k++)
+		dst2(p, u + 2 * k, (2 * k + 1 < n) ? u + 2 * k + 1 : NULL,
+		     (size_t) n, n, z, tmp);
+}
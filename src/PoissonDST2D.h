@@ -0,0 +1,57 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition directly
+ * with the discrete sine transform.
+ *
+ */
+
+#ifndef POISSONDST2D_H_INCLUDED
+#define POISSONDST2D_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief Direct solver of Poisson Equation.
+ *
+ * Solves the same 5-point equation as PoissonSOR2D(), with the same
+ * arguments, exactly up to rounding and without iterations. The boundary
+ * values of f are moved into the RHS, and the sine transform of the
+ * interior along x and then along y makes the equation diagonal: each
+ * coefficient is divided by its eigenvalue and transformed back. This
+ * takes O(N^2 log N) operations.
+ *
+ * The transforms are complex FFTs of length 2 (N - 1), two rows or columns
+ * at a time, and run in parallel over them with OpenMP. N - 1 a power of 2,
+ * N = 129 or 1025, is the fastest; other sizes go through Bluestein's
+ * algorithm, about 4 times slower.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f not allocated
+ */
+int PoissonDST2D(double *f, /**< [in, out] boundary in, result out */
+                 double (*g)(int, int, int), /**< [in] RHS of Poisson Eq */
+                 int N /**< [in] number of grid points in each dimension */);
+
+
+/** @brief Direct solver of Poisson Equation with a precomputed RHS.
+ *
+ * Same as PoissonDST2D(), with the RHS given as for PoissonSOR2DRHS().
+ * Only opts->stats is used: it gets the time of the solve, no sweeps and a
+ * norm of 0.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonDST2DRHS(double *f, /**< [in, out] boundary in, result out */
+                    const double *rhs, /**< [in] scaled RHS of Poisson Eq */
+                    int N, /**< [in] number of grid points in each dimension */
+                    const SOROptions *opts /**< [in] options, or NULL */);
+
+
+#endif
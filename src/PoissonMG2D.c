@@ -0,0 +1,345 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * geometric multigrid.
+ *
+ */
+
+
+#include "PoissonMG2D.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* One grid of the hierarchy. Level 0 is the user's grid. */
+typedef struct {
+	int N;
+	double *u;         /* solution or correction */
+	const double *rhs; /* RHS of this level */
+	double *rhs_buf;   /* storage of rhs on the coarse levels */
+	double *res;       /* residual */
+} MGLevel;
+
+
+static void restrictFW(double *coarse, const double *fine, int Nf, int Nc);
+static void prolong(double *fine, const double *coarse, int Nf, int Nc,
+                    int add);
+static void injectBoundary(double *coarse, const double *fine, int Nf,
+                           int Nc);
+static void solveCoarsest(MGLevel *lvl, const SORKernels *kern);
+static void vcycle(MGLevel *lvl, int l, int nlevels, const MGOptions *opts,
+                   const SORKernels *kern);
+
+
+void initMGOptions(MGOptions *opts)
+{
+	opts->pre = 2;
+	opts->post = 2;
+	opts->fmg = 0;
+	opts->kernel = SOR_KERNEL_AUTO;
+	opts->alloc = 0;
+	opts->log = printSORLog;
+	opts->logdata = NULL;
+}
+
+
+int PoissonMG2D(double *f, double (*g)(int, int, int),
+                int N, int tmax, double prec)
+{
+	double *rhs;
+	int ret;
+
+	if (NULL == f)
+		return 1;
+
+	if (!(rhs = (double *) malloc((size_t) N * N * sizeof(double)))) {
+		perror("RHS array allocation error:");
+		return -1;
+	}
+
+	fillRHS(rhs, g, N);
+	ret = PoissonMG2DRHS(f, rhs, N, tmax, prec, NULL);
+
+	free(rhs);
+	return ret;
+}
+
+
+int PoissonMG2DRHS(double *f, const double *rhs, int N, int tmax,
+                   double prec, const MGOptions *opts)
+{
+	MGOptions defaults;
+	const SORKernels *kern;
+	MGLevel lvl[32];
+	int l, n, nlevels = 0, t = 0, ret = 0;
+	double norm = prec + 42.;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+
+	if (NULL == opts) {
+		initMGOptions(&defaults);
+		opts = &defaults;
+	}
+
+	kern = selectSORKernels(opts->kernel);
+
+	/* coarsen down to 3 x 3 for any N, see restrictFW(). The grids of a
+	 * level are placed by the threads that smooth it. */
+	memset(lvl, 0, sizeof(lvl));
+	for (n = N; ; n = n / 2 + 1) {
+		lvl[nlevels].N = n;
+		if (0 == nlevels) {
+			lvl[0].u = f;
+			lvl[0].rhs = rhs;
+		} else if (!(lvl[nlevels].u = allocGrid(n, opts->alloc)) ||
+		           !(lvl[nlevels].rhs_buf = allocGrid(n, opts->alloc))) {
+			perror("Multigrid level allocation error:");
+			ret = -1;
+		} else {
+			lvl[nlevels].rhs = lvl[nlevels].rhs_buf;
+		}
+		if ((0 == ret) &&
+		    !(lvl[nlevels].res = allocGrid(n, opts->alloc))) {
+			perror("Multigrid level allocation error:");
+			ret = -1;
+		}
+		nlevels++;
+		if ((0 != ret) || (n <= 3) || (32 == nlevels))
+			break;
+	}
+
+	if (0 == ret) {
+		if (opts->fmg) {
+			/* the same problem on every level, solved from the
+			 * coarsest up, each one starting from the coarser
+			 * solution */
+			for (l = 1; l < nlevels; l++) {
+				restrictFW(lvl[l].rhs_buf, lvl[l - 1].rhs,
+				           lvl[l - 1].N, lvl[l].N);
+				injectBoundary(lvl[l].u, lvl[l - 1].u, lvl[l - 1].N,
+				               lvl[l].N);
+			}
+			solveCoarsest(&lvl[nlevels - 1], kern);
+			for (l = nlevels - 2; l >= 0; l--) {
+				prolong(lvl[l].u, lvl[l + 1].u, lvl[l].N,
+				        lvl[l + 1].N, 0);
+				vcycle(lvl, l, nlevels, opts, kern);
+			}
+			norm = residual(lvl[0].res, f, rhs, N) / 4.;
+			t++;
+			if (NULL != opts->log)
+				opts->log(opts->logdata, t, norm, prec);
+		}
+
+		while ((t < tmax) && (norm > prec)) {
+			vcycle(lvl, 0, nlevels, opts, kern);
+			norm = residual(lvl[0].res, f, rhs, N) / 4.;
+			t++;
+			if (NULL != opts->log)
+				opts->log(opts->logdata, t, norm, prec);
+		}
+	}
+
+	for (l = 0; l < nlevels; l++) {
+		if (l > 0) {
+			free(lvl[l].u);
+			free(lvl[l].rhs_buf);
+		}
+		free(lvl[l].res);
+	}
+
+	return ret;
+}
+
+
+/* The grids of the hierarchy span the same square: the coarse grid of a
+ * grid of Nf points has Nc = Nf / 2 + 1 points, and its point I lies at the
+ * fine coordinate I H, H = (Nf - 1) / (Nc - 1). For Nf odd H = 2 and the
+ * coarse points are every other fine point. For Nf even H is a bit less
+ * than 2 and the grids are not nested, so the transfers interpolate
+ * between them; this keeps every N coarsening down to 3 x 3. */
+
+
+/* Full weighting of the fine values onto the interior of the coarse grid,
+ * the transpose of prolong(): the fine point i weighs 1 - |i / H - I| on the
+ * coarse point I when it is less than H away, which for H = 2 are the
+ * weights 1/2, 1, 1/2 of the usual full weighting. The weights of a coarse
+ * point add up to about H^2, the ratio of the squared spacings, so the
+ * result is the scaled RHS of the coarse equation. */
+static void restrictFW(double *coarse, const double *fine, int Nf, int Nc)
+{
+	const double H = (Nf - 1.) / (Nc - 1.);
+	const double invH = (Nc - 1.) / (Nf - 1.);
+	int I, J, i, j, i0, i1, j0, j1;
+	double row, sum;
+
+	if (Nf == 2 * Nc - 1) {
+		/* the weights 1/2, 1, 1/2 spelled out */
+		#pragma omp parallel for private(I, i, j)
+		for (J = 1; J < Nc - 1; J++) {
+			for (I = 1; I < Nc - 1; I++) {
+				i = 2 * I;
+				j = 2 * J;
+				coarse[I + J * Nc] = 4. * fine[i + j * Nf] +
+				                     2. * (fine[i-1 +  j    * Nf] +
+				                           fine[i+1 +  j    * Nf] +
+				                           fine[i   + (j-1) * Nf] +
+				                           fine[i   + (j+1) * Nf]) +
+				                     fine[i-1 + (j-1) * Nf] +
+				                     fine[i+1 + (j-1) * Nf] +
+				                     fine[i-1 + (j+1) * Nf] +
+				                     fine[i+1 + (j+1) * Nf];
+				coarse[I + J * Nc] /= 4.;
+			}
+		}
+		return;
+	}
+
+	#pragma omp parallel for private(I, i, j, i0, i1, j0, j1, row, sum)
+	for (J = 1; J < Nc - 1; J++) {
+		j0 = (int) floor(H * (J - 1)) + 1;
+		j1 = (int) ceil(H * (J + 1)) - 1;
+		for (I = 1; I < Nc - 1; I++) {
+			i0 = (int) floor(H * (I - 1)) + 1;
+			i1 = (int) ceil(H * (I + 1)) - 1;
+			sum = 0.;
+			for (j = j0; j <= j1; j++) {
+				row = 0.;
+				for (i = i0; i <= i1; i++)
+					row += (1. - fabs(i * invH - I)) *
+					       fine[i + j * Nf];
+				sum += (1. - fabs(j * invH - J)) * row;
+			}
+			coarse[I + J * Nc] = sum;
+		}
+	}
+}
+
+
+/* Boundary values of the coarse grid, interpolated linearly along the
+ * sides of the fine grid. */
+static void injectBoundary(double *coarse, const double *fine, int Nf,
+                           int Nc)
+{
+	const double H = (Nf - 1.) / (Nc - 1.);
+	const size_t top = (size_t) (Nf - 1) * Nf;
+	int I, i;
+	double x;
+
+	for (I = 0; I < Nc; I++) {
+		x = I * H;
+		i = (x < Nf - 1) ? (int) x : Nf - 2;
+		x -= i;
+		/* y = 0, y = N-1, x = 0, x = N-1 */
+		coarse[I] = (1. - x) * fine[i] + x * fine[i + 1];
+		coarse[I + (Nc-1) * Nc] = (1. - x) * fine[i + top] +
+		                          x * fine[i + 1 + top];
+		coarse[I * Nc] = (1. - x) * fine[i * Nf] +
+		                 x * fine[(i + 1) * Nf];
+		coarse[Nc-1 + I * Nc] = (1. - x) * fine[Nf-1 + i * Nf] +
+		                        x * fine[Nf-1 + (i + 1) * Nf];
+	}
+}
+
+
+/* Bilinear interpolation of the coarse values onto the interior of the
+ * fine grid, added to it or replacing it. */
+static void prolong(double *fine, const double *coarse, int Nf, int Nc,
+                    int add)
+{
+	const double invH = (Nc - 1.) / (Nf - 1.);
+	int i, j, I, J;
+	double x, y, v;
+
+	if (Nf == 2 * Nc - 1) {
+		/* the coarse points are the even fine ones */
+		#pragma omp parallel for private(i, I, J, v)
+		for (j = 1; j < Nf - 1; j++) {
+			J = j / 2;
+			for (i = 1; i < Nf - 1; i++) {
+				I = i / 2;
+				v = coarse[I + J * Nc];
+				if (i % 2 && j % 2)
+					v = (v + coarse[I+1 + J * Nc] +
+					     coarse[I + (J+1) * Nc] +
+					     coarse[I+1 + (J+1) * Nc]) / 4.;
+				else if (i % 2)
+					v = (v + coarse[I+1 + J * Nc]) / 2.;
+				else if (j % 2)
+					v = (v + coarse[I + (J+1) * Nc]) / 2.;
+
+				if (add)
+					fine[i + j * Nf] += v;
+				else
+					fine[i + j * Nf] = v;
+			}
+		}
+		return;
+	}
+
+	#pragma omp parallel for private(i, I, J, x, y, v)
+	for (j = 1; j < Nf - 1; j++) {
+		y = j * invH;
+		J = (int) y;
+		y -= J;
+		for (i = 1; i < Nf - 1; i++) {
+			x = i * invH;
+			I = (int) x;
+			x -= I;
+			v = (1. - y) * ((1. - x) * coarse[I + J * Nc] +
+			                x * coarse[I+1 + J * Nc]) +
+			    y * ((1. - x) * coarse[I + (J+1) * Nc] +
+			         x * coarse[I+1 + (J+1) * Nc]);
+
+			if (add)
+				fine[i + j * Nf] += v;
+			else
+				fine[i + j * Nf] = v;
+		}
+	}
+}
+
+
+/* SOR on the coarsest grid, well past the precision of the cycles */
+static void solveCoarsest(MGLevel *lvl, const SORKernels *kern)
+{
+	const double gamma = SORParamSin(lvl->N);
+	int t;
+	double norm = 42.;
+
+	for (t = 0; (t < 50 * lvl->N) && (norm > 1.E-14); t++)
+		update(lvl->u, lvl->rhs, &norm, gamma, lvl->N, kern);
+}
+
+
+static void vcycle(MGLevel *lvl, int l, int nlevels, const MGOptions *opts,
+                   const SORKernels *kern)
+{
+	MGLevel *fine = &lvl[l];
+	MGLevel *coarse = &lvl[l + 1];
+	int t;
+
+	if (l == nlevels - 1) {
+		solveCoarsest(fine, kern);
+		return;
+	}
+
+	for (t = 0; t < opts->pre; t++)
+		update(fine->u, fine->rhs, NULL, 1., fine->N, kern);
+
+	/* coarse equation for the correction, with zero boundary */
+	residual(fine->res, fine->u, fine->rhs, fine->N);
+	restrictFW(coarse->rhs_buf, fine->res, fine->N, coarse->N);
+	memset(coarse->u, 0, coarse->N * coarse->N * sizeof(double));
+
+	vcycle(lvl, l + 1, nlevels, opts, kern);
+
+	prolong(fine->u, coarse->u, fine->N, coarse->N, 1);
+
+	for (t = 0; t < opts->post; t++)
+		update(fine->u, fine->rhs, NULL, 1., fine->N, kern);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * geometric multigrid.
+ *
+ */
+
+#ifndef POISSONMG2D_H_INCLUDED
+#define POISSONMG2D_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief Tunables of the multigrid solver. */
+typedef struct {
+	int pre;          /**< smoothing sweeps before the coarse correction */
+	int post;         /**< smoothing sweeps after the coarse correction */
+	int fmg;          /**< start with a full multigrid pass, ignoring f */
+	SORKernel kernel; /**< instruction set of the smoothing sweeps */
+	int alloc;        /**< flags of the level grids, see allocGrid() */
+	/** progress lines, one per cycle with the cycles done in place of the
+	 * sweeps, printSORLog() by default, or NULL for none */
+	SORLog log;
+	void *logdata;    /**< first argument of log */
+} MGOptions;
+
+
+/** @brief Set all multigrid options to their default values. */
+void initMGOptions(MGOptions *opts /**< [out] options to initialize */);
+
+
+/** @brief Multigrid solver of Poisson Equation.
+ *
+ * Solves the same problem as PoissonSOR2D(), with the same conventions for
+ * f, g and the boundary values, using multigrid V-cycles. Each cycle
+ * smooths with red-black Gauss-Seidel sweeps (update() with gamma = 1),
+ * restricts the residual with full weighting to a grid of N / 2 + 1
+ * points, corrects with the coarse solution interpolated bilinearly, and
+ * smooths again. The coarsest grid is solved with SOR.
+ *
+ * Each grid of N points is coarsened to N / 2 + 1 points down to 3 x 3,
+ * and the number of cycles does not depend on N. For N = 2^k + 1 the
+ * coarse points are every other fine point; for other sizes the grids are
+ * not nested and the transfers interpolate between them.
+ *
+ * tmax is the maximum number of V-cycles. The solver stops when a cycle
+ * leaves a norm below prec. The norm is the largest residual divided by 4,
+ * the change a Gauss-Seidel sweep would still make, so prec means the same
+ * as for PoissonSOR2D().
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f not allocated
+ */
+int PoissonMG2D(double *f, /**< [in, out] numerical result */
+                double (*g)(int, int, int), /**< [in] RHS of Poisson Eq */
+                int N, /**< [in] number of grid points in each dimension */
+                int tmax, /**< [in] maximum number of V-cycles */
+                double prec /**< [in] desired precision */);
+
+
+/** @brief Multigrid solver of Poisson Equation with a precomputed RHS.
+ *
+ * Same as PoissonMG2D(), with the RHS given as for PoissonSOR2DRHS().
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonMG2DRHS(double *f, /**< [in, out] numerical result */
+                   const double *rhs, /**< [in] scaled RHS of Poisson Eq */
+                   int N, /**< [in] number of grid points in each dimension */
+                   int tmax, /**< [in] maximum number of V-cycles */
+                   double prec, /**< [in] desired precision */
+                   const MGOptions *opts /**< [in] options, or NULL */);
+
+
+#endif
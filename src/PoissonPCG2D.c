@@ -0,0 +1,158 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * conjugate gradients preconditioned with symmetric SOR.
+ *
+ */
+
+
+#include "PoissonPCG2D.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static double dot(const double *a, const double *b, int N);
+static double stencil(double *q, const double *p, int N);
+
+
+int PoissonPCG2D(double *f, double (*g)(int, int, int), double gamma,
+                 int N, int tmax, double prec)
+{
+	double *rhs;
+	int ret;
+
+	if (NULL == f)
+		return 1;
+
+	if (!(rhs = (double *) malloc((size_t) N * N * sizeof(double)))) {
+		perror("RHS array allocation error:");
+		return -1;
+	}
+
+	fillRHS(rhs, g, N);
+	ret = PoissonPCG2DRHS(f, rhs, gamma, N, tmax, prec, NULL);
+
+	free(rhs);
+	return ret;
+}
+
+
+/* The equation is A f = b with A = 4 - (sum of the 4 neighbors), which is
+ * symmetric positive definite on the interior points. The residual
+ * r = b - A f is kept negated in res, the form used by residual() and by
+ * the sweeps: the SOR sweeps on L z = res, L = -A, from z = 0 give the
+ * preconditioned residual z = M^-1 r. */
+int PoissonPCG2DRHS(double *f, const double *rhs, double gamma,
+                    int N, int tmax, double prec, const SOROptions *opts)
+{
+	SOROptions defaults;
+	const SORKernels *kern;
+	double *buf, *res, *z, *p, *q;
+	const size_t size = (size_t) N * N;
+	size_t n;
+	int t = 0;
+	double norm, rz, rz_old, alpha, beta;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+
+	if (NULL == opts) {
+		initSOROptions(&defaults);
+		opts = &defaults;
+	}
+
+	kern = selectSORKernels(opts->kernel);
+
+	/* placed by the threads that sweep the rows in updateSSOR() */
+	if (!(buf = (double *) allocRows(N * sizeof(double), N, 4,
+	                                 opts->alloc))) {
+		perror("PCG arrays allocation error:");
+		return -1;
+	}
+	res = buf;
+	z = res + size;
+	p = z + size;
+	q = p + size;
+
+	norm = residual(res, f, rhs, N) / 4.;
+
+	/* z = M^-1 r, p = z */
+	updateSSOR(z, res, NULL, gamma, N, kern);
+	memcpy(p, z, size * sizeof(double));
+	memset(z, 0, size * sizeof(double));
+	rz = -dot(res, p, N);
+
+	while ((t < tmax) && (norm > prec)) {
+		/* q = A p */
+		alpha = rz / stencil(q, p, N);
+
+		/* f += alpha p, r -= alpha q */
+		norm = 0;
+		#pragma omp parallel for reduction(max:norm)
+		for (n = 0; n < size; n++) {
+			f[n] += alpha * p[n];
+			res[n] += alpha * q[n];
+			norm = (fabs(res[n]) > norm) ? fabs(res[n]) : norm;
+		}
+		norm /= 4.;
+
+		updateSSOR(z, res, NULL, gamma, N, kern);
+		rz_old = rz;
+		rz = -dot(res, z, N);
+		beta = rz / rz_old;
+
+		/* z goes back to 0 for the next step */
+		#pragma omp parallel for
+		for (n = 0; n < size; n++) {
+			p[n] = z[n] + beta * p[n];
+			z[n] = 0.;
+		}
+
+		t++;
+		if ((NULL != opts->log) && (t % 100 == 0 || norm < prec))
+			opts->log(opts->logdata, t, norm, prec);
+	}
+
+	free(buf);
+	return 0;
+}
+
+
+static double dot(const double *a, const double *b, int N)
+{
+	const size_t size = (size_t) N * N;
+	size_t n;
+	double sum = 0;
+
+	#pragma omp parallel for reduction(+:sum)
+	for (n = 0; n < size; n++)
+		sum += a[n] * b[n];
+
+	return sum;
+}
+
+
+/* q = A p on the interior. The boundary of q is left as it is, 0 from the
+ * allocation. Returns p.q, summed in the same pass. */
+static double stencil(double *q, const double *p, int N)
+{
+	int i, j;
+	double sum = 0;
+
+	#pragma omp parallel for private(i) reduction(+:sum)
+	for (j = 1; j < N - 1; j++) {
+		for (i = 1; i < N - 1; i++) {
+			q[i + j * N] = 4. * p[i + j * N] -
+			               (p[i-1 +  j    * N] +
+			                p[i+1 +  j    * N] +
+			                p[i   + (j-1) * N] +
+			                p[i   + (j+1) * N]);
+			sum += p[i + j * N] * q[i + j * N];
+		}
+	}
+
+	return sum;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * conjugate gradients preconditioned with symmetric SOR.
+ *
+ */
+
+#ifndef POISSONPCG2D_H_INCLUDED
+#define POISSONPCG2D_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief Preconditioned Conjugate Gradient solver of Poisson Equation.
+ *
+ * Solves the same problem as PoissonSOR2D(), with the same arguments, using
+ * conjugate gradients on the 5-point equation. The matrix is never stored:
+ * it is applied as the stencil. The preconditioner is one symmetric SOR
+ * step of parameter gamma from a zero guess, see updateSSOR(), so it costs
+ * one and a half SOR sweeps per iteration.
+ *
+ * tmax is the maximum number of CG iterations. The solver stops when the
+ * largest residual divided by 4 is below prec. This is the change a
+ * Gauss-Seidel sweep would still make, as for PoissonMG2D(), and unlike the
+ * change of the last sweep used by PoissonSOR2D() it does not get small
+ * just because the iteration is slow.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f not allocated
+ */
+int PoissonPCG2D(double *f, /**< [in, out] numerical result */
+                 double (*g)(int, int, int), /**< [in] RHS of Poisson Eq */
+                 double gamma, /**< [in] SSOR parameter */
+                 int N, /**< [in] number of grid points in each dimension */
+                 int tmax, /**< [in] maximum number of iterations */
+                 double prec /**< [in] desired precision */);
+
+
+/** @brief PCG solver of Poisson Equation with a precomputed RHS.
+ *
+ * Same as PoissonPCG2D(), with the RHS given as for PoissonSOR2DRHS().
+ * Only opts->kernel is used.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonPCG2DRHS(double *f, /**< [in, out] numerical result */
+                    const double *rhs, /**< [in] scaled RHS of Poisson Eq */
+                    double gamma, /**< [in] SSOR parameter */
+                    int N, /**< [in] number of grid points in each dimension */
+                    int tmax, /**< [in] maximum number of iterations */
+                    double prec, /**< [in] desired precision */
+                    const SOROptions *opts /**< [in] options, or NULL */);
+
+
+/** @brief SSOR parameter for the PCG preconditioner.
+ *
+ * With the red-black ordering the condition number of the preconditioned
+ * system does not improve in order with omega as for the natural ordering.
+ * Over-relaxing only adds iterations, so use symmetric Gauss-Seidel.
+ *
+ * @return SSOR parameter
+ */
+static inline double SSORParamPCG(int N /**< [in] grid size in one dimension */)
+{
+	(void) N;
+	return 1.;
+}
+
+
+#endif
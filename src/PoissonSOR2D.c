@@ -7,130 +7,1208 @@
 
 
 #include "PoissonSOR2D.h"
+#include "PoissonSOR2D_Writer.h"
+#include "PoissonSOR2D_Telemetry.h"
+#include <errno.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
 
+/* the values of a binary solution file start 64 bytes in */
+typedef char SORFileHeaderSize[(64 == sizeof(SORFileHeader)) ? 1 : -1];
+
+
+/* Grid as seen by the sweeps. color[c] holds the points of color c (0 is
+ * black, 1 is red) and rhs[c] their RHS, both with rows ld values apart.
+ * In the natural layout both colors are the same array. rows are the row
+ * kernels by SORTrack for the kind of RHS, see SORRhs; the ones of a
+ * constant RHS read value instead of rhs. */
+typedef struct {
+	double *color[2];
+	const double *rhs[2];
+	int ld;
+	const SORRowKernel *rows;
+	int kind;
+	double value;
+} SORGrid;
+
+
+/* doubles between the norms of two threads, so each has its own cache line */
+#define SOR_PAD 8
+
+
+/* alignment of the grids with SOR_ALLOC_HUGE, the size of a huge page */
+#define SOR_HUGE_PAGE ((size_t) 2 << 20)
+
+
+/* Arrays of a solve, kept by a SORSolver from one solve to the next.
+ * grid has the colors and RHS in the workspace: all of them in the split
+ * layout, and only the RHS copy of a SORSolver in the natural one. buf
+ * holds the arrays of grid, cheb the Chebyshev iterates, work the norms
+ * and scratch rows of nthreads threads. */
+typedef struct {
+	SORGrid grid;
+	double *buf;
+	double *cheb;
+	double *work;
+	const SORRowKernel (*kernels)[SOR_TRACKS]; /* of the layout */
+	size_t size; /* values of one iterate */
+	int N;
+	int nthreads;
+} SORWork;
+
+
+/* State of the adaptive SOR parameter, see adaptGamma() */
+typedef struct {
+	double norm;  /* norm of the last step */
+	double ratio; /* ratio of the last two norms, per sweep */
+	int stable;   /* steps with the ratio about constant */
+} SORAdapt;
+
+
+static void fitOptions(SOROptions *opts);
+static int initWork(SORWork *w, int N, const SOROptions *opts, int rhs);
+static int growWork(SORWork *w);
+static void freeWork(SORWork *w);
+static void setRHSKind(SORWork *w, const double *rhs);
+static void compactRHS(double *dst, const double *rhs, int N);
+static int solveWork(SORWork *w, double *f, const double *rhs, double gamma,
+                     int tmax, double prec, const SOROptions *opts,
+                     SORStats *stats);
+static inline double joinNorms(double a, double b, int track);
+static void threadBand(size_t n, size_t *lo, size_t *hi);
+static double *allocBands(size_t ld, int rows, int n, int flags);
+static double sweepBand(const SORGrid *grid, int c, double gamma, int N,
+                        int track, int j0, int j1);
+static double sweepColor(const SORGrid *grid, int c, double gamma, int N,
+                         int track);
+static double sweepWavefront(const SORGrid *grid, double gamma, int N,
+                             int sweeps, int track);
+static double sweepCompact(const SORGrid *grid, double gamma, int N,
+                           int track, int j0, int j1);
+static double sweepSSORBand(const SORGrid *grid, double gamma, int N,
+                            int track, int j0, int j1);
+static double sweepSSOR(const SORGrid *grid, double gamma, int N, int track);
+static double adaptGamma(SORAdapt *adapt, double gamma, double norm,
+                         int sweeps);
+static double sweepChebyshev(const SORGrid *grid, double *sol, double *prev,
+                             const double *cur, double gamma, double e,
+                             double omega, int N, int track, int j0, int j1);
+static inline void combineRange(double *sol, double *prev, const double *cur,
+                                size_t n0, size_t n1, double e, double omega);
+static double residualBand(const SORGrid *grid, int N, int j0, int j1,
+                           double *scratch);
+static void copyRows(const SORGrid *grid, double *f, int N, size_t j0,
+                     size_t j1);
+static double *readText(const char *path, int *M);
+static void interpolate(double *f, int N, const double *src, int M);
+
+
+void initSOROptions(SOROptions *opts)
+{
+	opts->layout = SOR_LAYOUT_NATURAL;
+	opts->kernel = SOR_KERNEL_AUTO;
+	opts->wavefront = 1;
+	opts->accel = SOR_ACCEL_NONE;
+	opts->stencil = SOR_STENCIL_5;
+	opts->adaptive = 0;
+	opts->check.every = 1;
+	opts->check.growth = 1.;
+	opts->check.norm = SOR_NORM_MAX;
+	opts->stats = NULL;
+	opts->writer = NULL;
+	opts->snapshot = 0;
+	opts->start = 0;
+	opts->resume = NULL;
+	opts->telemetry = NULL;
+	opts->alloc = 0;
+	opts->log = printSORLog;
+	opts->logdata = NULL;
+}
+
+
+double *allocGrid(int N, int flags)
+{
+	return allocBands(N, N, 1, flags);
+}
+
+
 int PoissonSOR2D(double *f, double (*g)(int, int, int), double gamma,
                  int N, int tmax, double prec)
 {
-	double *f_tmp;
-	int i, t = 0;
-	double norm = prec + 42.;
-	#ifdef _OPENMP
-	const int chunk = ceil(N / omp_get_max_threads());
-	#endif
+	double *rhs;
+	int ret;
 
 	if (NULL == f)
 		return 1;
 
-	if (!(f_tmp = (double *) calloc(N * N, sizeof(double)))) {
-		perror("Temporary array allocation error:");
+	if (!(rhs = allocGrid(N, 0))) {
+		perror("RHS array allocation error:");
 		return -1;
 	}
 
-	/* copy boundary conditions */
-	#pragma omp parallel for schedule(static, chunk)
-	for (i = 0; i < N; i++) {
-		f_tmp[i] = f[i]; /* y = 0 */
-		f_tmp[i + (N-1) * N] = f[i + (N-1) * N]; /* y = N - 1 */
-		f_tmp[0 + i * N] = f[0 + i * N]; /* x = 0 */
-		f_tmp[N-1 + i * N] = f[N-1 + i * N]; /* x = N-1 */
+	fillRHS(rhs, g, N);
+	ret = PoissonSOR2DRHS(f, rhs, gamma, N, tmax, prec, NULL);
+
+	free(rhs);
+	return ret;
+}
+
+
+int PoissonSOR2DRHS(double *f, const double *rhs, double gamma,
+                    int N, int tmax, double prec, const SOROptions *opts)
+{
+	SOROptions run;
+	SORWork w;
+	SORStats stats;
+	int ret;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+
+	if (NULL == opts)
+		initSOROptions(&run);
+	else
+		run = *opts;
+	fitOptions(&run);
+
+	if (initWork(&w, N, &run, 0))
+		return -1;
+	ret = solveWork(&w, f, rhs, gamma, tmax, prec, &run, &stats);
+	if ((0 == ret) && (NULL != run.stats))
+		*run.stats = stats;
+	freeWork(&w);
+
+	return ret;
+}
+
+
+struct SORSolver {
+	SOROptions opts;
+	SORWork work;
+	SORStats stats;
+	double gamma;
+	int N;
+	int rhs; /* the RHS is in the workspace */
+};
+
+
+SORSolver *openSORSolver(int N, double gamma, const SOROptions *opts)
+{
+	SORSolver *s;
+
+	if (!(s = (SORSolver *) calloc(1, sizeof(SORSolver)))) {
+		perror("Solver allocation error:");
+		return NULL;
+	}
+	if (NULL == opts)
+		initSOROptions(&s->opts);
+	else
+		s->opts = *opts;
+	fitOptions(&s->opts);
+	s->gamma = gamma;
+	s->N = N;
+	if (initWork(&s->work, N, &s->opts, 1)) {
+		free(s);
+		return NULL;
 	}
 
-	while ((t < tmax) && (norm > prec)) {
-		update(f_tmp, f, g, NULL, gamma, N);
-		update(f, f_tmp, g, &norm, gamma, N);
-		t += 2;
-		if (t % 100 == 0 || norm < prec)
-			printf("t, norm, prec: %4d %.9f %.9f\n", t, norm, prec);
+	return s;
+}
+
+
+int setSORSolverRHS(SORSolver *s, const double *rhs)
+{
+	const SORGrid *grid;
+
+	if ((NULL == s) || (NULL == rhs))
+		return 1;
+
+	grid = &s->work.grid;
+	if (SOR_LAYOUT_REDBLACK == s->opts.layout) {
+		toRedBlack(rhs, (double *) grid->rhs[1], (double *) grid->rhs[0],
+		           s->N);
+	} else if (SOR_STENCIL_9 == s->opts.stencil) {
+		/* the kind is that of the corrected RHS */
+		compactRHS((double *) grid->rhs[0], rhs, s->N);
+		rhs = grid->rhs[0];
+	} else {
+		memcpy((double *) grid->rhs[0], rhs,
+		       (size_t) s->N * s->N * sizeof(double));
 	}
+	setRHSKind(&s->work, rhs);
+	s->rhs = 1;
 
-	free(f_tmp);
 	return 0;
 }
 
 
-void update(double *f, double *f_old, double (*g)(int, int, int),
-            double *norm, double gamma, int N)
+int solveSORSolver(SORSolver *s, double *f, int tmax, double prec)
 {
-	int i = 1, j, k = 0;
-	double lnorm = 0;
+	int ret;
+
+	if ((NULL == s) || (NULL == f) || !s->rhs)
+		return 1;
+
+	ret = solveWork(&s->work, f, NULL, s->gamma, tmax, prec, &s->opts,
+	                &s->stats);
+	if ((0 == ret) && (NULL != s->opts.stats))
+		*s->opts.stats = s->stats;
+
+	return ret;
+}
+
+
+void getSORSolverStats(const SORSolver *s, SORStats *stats)
+{
+	*stats = s->stats;
+}
+
+
+void closeSORSolver(SORSolver *s)
+{
+	if (NULL == s)
+		return;
+
+	freeWork(&s->work);
+	free(s);
+}
+
+
+void printSORLog(void *data, int sweeps, double norm, double prec)
+{
+	(void) data;
+	printf("t, norm, prec: %4d %.9f %.9f\n", sweeps, norm, prec);
+}
+
+
+/* Drops the options the compact stencil does not run with: it only has
+ * the natural layout and plain SOR sweeps. */
+static void fitOptions(SOROptions *opts)
+{
+	if (SOR_STENCIL_9 != opts->stencil)
+		return;
+
+	opts->layout = SOR_LAYOUT_NATURAL;
+	opts->wavefront = 1;
+	opts->accel = SOR_ACCEL_NONE;
+}
+
+
+/* Allocates the arrays of a solve of the given options. With rhs, the
+ * natural layout also gets its own copy of the RHS, which the red-black
+ * layout and the compact stencil always have. */
+static int initWork(SORWork *w, int N, const SOROptions *opts, int rhs)
+{
+	const SORKernels *kern = selectSORKernels(opts->kernel);
+	const int W = (N + 1) / 2;
+	const size_t half = (size_t) N * W;
+
+	memset(w, 0, sizeof(SORWork));
+	w->N = N;
+	if (SOR_LAYOUT_REDBLACK == opts->layout) {
+		if (!(w->buf = allocBands(W, N, 4, opts->alloc))) {
+			perror("Red-black arrays allocation error:");
+			return -1;
+		}
+		w->grid.color[1] = w->buf;
+		w->grid.color[0] = w->buf + half;
+		w->grid.rhs[1] = w->buf + 2 * half;
+		w->grid.rhs[0] = w->buf + 3 * half;
+		w->grid.ld = W;
+		w->kernels = kern->redblackRHS;
+		w->size = 2 * half;
+	} else {
+		if ((rhs || (SOR_STENCIL_9 == opts->stencil)) &&
+		    !(w->buf = allocBands(N, N, 1, opts->alloc))) {
+			perror("RHS array allocation error:");
+			return -1;
+		}
+		w->grid.rhs[0] = w->grid.rhs[1] = w->buf;
+		w->grid.ld = N;
+		w->kernels = (SOR_STENCIL_9 == opts->stencil) ? kern->compactRHS
+		                                              : kern->naturalRHS;
+		w->size = (size_t) N * N;
+	}
+	w->grid.rows = w->kernels[SOR_RHS_ARRAY];
+	w->grid.kind = SOR_RHS_ARRAY;
+
+	/* the two previous iterates, see sweepChebyshev() */
+	if ((SOR_ACCEL_CHEBYSHEV == opts->accel) &&
+	    !(w->cheb = allocBands(w->grid.ld, N, 2 * w->size / N / w->grid.ld,
+	                           opts->alloc))) {
+		perror("Chebyshev arrays allocation error:");
+		freeWork(w);
+		return -1;
+	}
+
+	return growWork(w);
+}
+
+
+/* Per thread: its norm, alone on a cache line, and a scratch row. Grows
+ * the thread arrays when the team got larger since the last solve. */
+static int growWork(SORWork *w)
+{
+	int nthreads = 1;
+
 	#ifdef _OPENMP
-	const int chunk = ceil(N / omp_get_max_threads());
+	nthreads = omp_get_max_threads();
 	#endif
+	if (nthreads <= w->nthreads)
+		return 0;
+
+	free(w->work);
+	w->nthreads = 0;
+	if (!(w->work = (double *) malloc(nthreads * (SOR_PAD + w->grid.ld) *
+	                                   sizeof(double)))) {
+		perror("Thread arrays allocation error:");
+		freeWork(w);
+		return -1;
+	}
+	w->nthreads = nthreads;
+
+	return 0;
+}
+
+
+static void freeWork(SORWork *w)
+{
+	free(w->buf);
+	free(w->cheb);
+	free(w->work);
+	w->buf = w->cheb = w->work = NULL;
+}
+
 
-	if (NULL != norm) {
-		/* for all black grid points in the interior of the grid */
-		#pragma omp parallel for reduction(max:lnorm) private(i,j,k) shared(f,f_old) schedule(static,chunk)
-		for (j = 1; j < N - 1; j++) { /* y loop */
-			k = (j+1) % 2;
-			for (i = 1 + k; i < N - 1; i += 2) { /* x loop */
-				f[i + j * N] = f_old[i + j * N] +
-				               gamma * (f_old[i-1 +  j    * N] +
-				                        f_old[i+1 +  j    * N] +
-				                        f_old[i   + (j-1) * N] +
-				                        f_old[i   + (j+1) * N] -
-				                        4. * f_old[i  + j * N] -
-				                        g(i, j, N)/N/N) / 4.;
-				lnorm = fmax(lnorm, fabs(f_old[i + j * N] - f[i + j * N]));
+/* Picks the kernels of the workspace for the RHS rhs, in the natural
+ * layout: the interior points are compared with the first one, up to the
+ * first that differs. The boundary values of the RHS are never used. */
+static void setRHSKind(SORWork *w, const double *rhs)
+{
+	const int N = w->N;
+	const double value = (N > 2) ? rhs[1 + N] : 0.;
+	int i, j, kind = (0. == value) ? SOR_RHS_ZERO : SOR_RHS_CONST;
+
+	for (j = 1; (j < N - 1) && (SOR_RHS_ARRAY != kind); j++)
+		for (i = 1; i < N - 1; i++)
+			if (rhs[i + (size_t) j * N] != value) {
+				kind = SOR_RHS_ARRAY;
+				break;
 			}
-		}
 
-		/* for all red grid points in the interior of the grid */
-		#pragma omp parallel for reduction(max:lnorm) private(i,j,k) shared(f,f_old) schedule(static,chunk)
-		for (j = 1; j < N - 1; j++) { /* y loop */
-			k = (j) % 2;
-			for (i = 1 + k; i < N - 1; i += 2) { /* x loop */
-				f[i + j * N] = f_old[i + j * N] +
-				               gamma * (f[i-1 +  j    * N] +
-				                        f[i+1 +  j    * N] +
-				                        f[i   + (j-1) * N] +
-				                        f[i   + (j+1) * N] -
-				                        4. * f_old[i  + j * N] -
-				                        g(i, j, N)/N/N) / 4.;
-				lnorm = fmax(lnorm, fabs(f_old[i + j * N] - f[i + j * N]));
+	w->grid.kind = kind;
+	w->grid.value = value;
+	w->grid.rows = w->kernels[kind];
+}
+
+
+/* The solve proper. rhs is NULL when it is already in the workspace. */
+static int solveWork(SORWork *w, double *f, const double *rhs, double gamma,
+                     int tmax, double prec, const SOROptions *opts,
+                     SORStats *stats)
+{
+	SORGrid grid;
+	SORAdapt adapt = {0., 0., 0};
+	struct timespec t0, t1;
+	double *sol, *prev = NULL, *cur = NULL, *work;
+	double *snap = NULL;
+	const size_t size = w->size;
+	const int N = w->N;
+	int nthreads, track, tdone = 0, last, printed;
+	int checks = 0, interval = 0;
+	double norm = prec + 42.;
+	double rho, e = 1., rho2 = 0.;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (growWork(w))
+		return -1;
+	nthreads = w->nthreads;
+	work = w->work;
+
+	if ((NULL != rhs) && (SOR_STENCIL_9 == opts->stencil)) {
+		/* the sweeps read the corrected RHS from the workspace */
+		compactRHS(w->buf, rhs, N);
+		rhs = w->buf;
+	}
+	if (NULL != rhs)
+		setRHSKind(w, rhs);
+	grid = w->grid;
+	if (SOR_LAYOUT_REDBLACK == opts->layout) {
+		toRedBlack(f, grid.color[1], grid.color[0], N);
+		if (NULL != rhs)
+			toRedBlack(rhs, (double *) grid.rhs[1],
+			           (double *) grid.rhs[0], N);
+		sol = w->buf;
+	} else {
+		/* f is updated in place, the boundary values are never written */
+		grid.color[0] = grid.color[1] = f;
+		if (NULL != rhs)
+			grid.rhs[0] = grid.rhs[1] = rhs;
+		sol = f;
+	}
+
+	if (NULL != w->cheb) {
+		prev = w->cheb;
+		cur = w->cheb + size;
+		memset(prev, 0, size * sizeof(double));
+		memcpy(cur, sol, size * sizeof(double));
+		rho = SSORRadius(gamma, N);
+		e = 2. / (2. - rho);
+		rho2 = rho * e / 2.;
+		rho2 *= rho2;
+	}
+
+	last = printed = opts->start;
+	if ((NULL != opts->resume) && (opts->resume->norm > prec)) {
+		norm = opts->resume->norm;
+		interval = opts->resume->interval;
+	}
+	track = (SOR_NORM_L2 == opts->check.norm) ? SOR_TRACK_SUM2 :
+	        (SOR_NORM_MAX == opts->check.norm) ? SOR_TRACK_MAX :
+	        SOR_TRACK_NONE;
+	/* One parallel region for the whole solve. Each thread sweeps its own
+	 * band of rows and waits for the others at a barrier after each color.
+	 * The loop counters are kept by every thread, which all take the same
+	 * decisions; only the checks go through a single thread. */
+	#pragma omp parallel
+	{
+		size_t j0, j1, r0, r1;
+		int tid = 0, nth = 1, t = opts->start, next, sweeps, k;
+		double every, lnorm, omega = 1., *p = prev, *q = cur, *swap;
+		double *scratch;
+
+		#ifdef _OPENMP
+		tid = omp_get_thread_num();
+		nth = omp_get_num_threads();
+		#endif
+		scratch = work + nthreads * SOR_PAD + tid * grid.ld;
+		threadBand(N - 2, &j0, &j1);
+		j0++;
+		j1++;
+		every = (opts->check.every > 1) ? opts->check.every : 1;
+		if ((NULL != opts->resume) && (opts->resume->interval > 0))
+			every = opts->resume->interval * opts->check.growth;
+		next = (every < tmax - t) ? t + (int) every : tmax;
+		SOR_TEL_BEGIN(opts->telemetry);
+
+		while ((t < tmax) && (norm > prec)) {
+			/* the step stops at the next check, and only its last
+			 * sweep computes the norm */
+			sweeps = (opts->wavefront < next - t) ? opts->wavefront
+			                                      : next - t;
+			if (NULL != w->cheb) {
+				sweeps = 1;
+				lnorm = sweepChebyshev(&grid, sol, p, q, gamma, e,
+				                       omega, N,
+				                       (t + 1 == next) ? track : 0,
+				                       j0, j1);
+				/* p has the new iterate and q the one before */
+				swap = p;
+				p = q;
+				q = swap;
+				omega = (opts->start == t) ? 1. / (1. - rho2 / 2.)
+				                 : 1. / (1. - rho2 * omega / 4.);
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_STEP);
+			} else if (SOR_STENCIL_9 == opts->stencil) {
+				lnorm = sweepCompact(&grid, gamma, N,
+				                     (t + 1 == next) ? track : 0,
+				                     j0, j1);
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_STEP);
+			} else if (sweeps > 1) {
+				lnorm = sweepWavefront(&grid, gamma, N, sweeps,
+				                       (t + sweeps == next) ? track
+				                                            : 0);
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_STEP);
+			} else {
+				k = (t + 1 == next) ? track : 0;
+				lnorm = sweepBand(&grid, 0, gamma, N, k, j0, j1);
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_BLACK);
+				#pragma omp barrier
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_SYNC);
+				lnorm = joinNorms(lnorm, sweepBand(&grid, 1, gamma,
+				                  N, k, j0, j1), track);
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_RED);
+			}
+			t += sweeps;
+			#pragma omp barrier
+			if ((NULL != opts->writer) && (opts->snapshot > 0) &&
+			    (t / opts->snapshot > (t - sweeps) / opts->snapshot)) {
+				/* each thread copies a band, the writer thread
+				 * does the rest while the sweeps go on */
+				#pragma omp single
+				snap = beginSnapshot(opts->writer);
+				threadBand(N, &r0, &r1);
+				copyRows(&grid, snap, N, r0, r1);
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_SYNC);
+				#pragma omp barrier
+				#pragma omp single nowait
+				{
+					SORStats snapst = {t, checks, interval,
+					                   norm, 0.};
+					commitSnapshot(opts->writer, &snapst);
+				}
 			}
+			if (t < next) {
+				SOR_TEL_STEP(opts->telemetry, t, 0, norm);
+				continue;
+			}
+
+			SOR_TEL_MARK(opts->telemetry, SOR_PHASE_SYNC);
+			if (SOR_NORM_RESIDUAL == opts->check.norm)
+				lnorm = residualBand(&grid, N, j0, j1, scratch);
+			work[tid * SOR_PAD] = lnorm;
+			SOR_TEL_MARK(opts->telemetry, SOR_PHASE_REDUCE);
+			#pragma omp barrier
+			SOR_TEL_MARK(opts->telemetry, SOR_PHASE_SYNC);
+			#pragma omp single
+			{
+				lnorm = 0;
+				for (k = 0; k < nth; k++)
+					lnorm = joinNorms(lnorm, work[k * SOR_PAD],
+					                  track);
+				if (SOR_NORM_L2 == opts->check.norm)
+					norm = sqrt(lnorm / ((N - 2.) * (N - 2.)));
+				else
+					norm = lnorm;
+				checks++;
+				interval = t - last;
+				last = t;
+				if (opts->adaptive && (NULL == w->cheb))
+					gamma = adaptGamma(&adapt, gamma, norm,
+					                   interval);
+				if ((NULL != opts->log) &&
+				    ((t / 100 > printed / 100) || norm < prec)) {
+					opts->log(opts->logdata, t, norm, prec);
+					printed = t;
+				}
+				SOR_TEL_MARK(opts->telemetry, SOR_PHASE_REDUCE);
+			}
+			SOR_TEL_STEP(opts->telemetry, t, 1, norm);
+			every *= opts->check.growth;
+			next = t + ((every > 1) ? (int) every : 1);
+			if (next > tmax)
+				next = tmax;
+		}
+
+		SOR_TEL_END(opts->telemetry);
+		#pragma omp master
+		tdone = t;
+	}
+
+	if (SOR_LAYOUT_REDBLACK == opts->layout)
+		fromRedBlack(f, grid.color[1], grid.color[0], N);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	stats->sweeps = tdone;
+	stats->checks = checks;
+	stats->interval = interval;
+	stats->norm = norm;
+	stats->time = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1.E9;
+
+	return 0;
+}
+
+
+/* RHS of the compact stencil from the scaled RHS of the 5-point one,
+ * r = h^2 g: 6 h^2 (g + h^2 / 12 Lap(g)), with the Laplacian of g by 5
+ * points, is (8 r + the 4 neighbors of r) / 2. The boundary values of rhs
+ * are read, those of dst are not written. */
+static void compactRHS(double *dst, const double *rhs, int N)
+{
+	int i, j;
+
+	#pragma omp parallel for private(i)
+	for (j = 1; j < N - 1; j++)
+		for (i = 1; i < N - 1; i++)
+			dst[i + (size_t) j * N] =
+			        (8. * rhs[i + (size_t) j * N] +
+			         rhs[i-1 + (size_t) j * N] +
+			         rhs[i+1 + (size_t) j * N] +
+			         rhs[i + (size_t) (j-1) * N] +
+			         rhs[i + (size_t) (j+1) * N]) / 2.;
+}
+
+
+void fillRHS(double *rhs, double (*g)(int, int, int), int N)
+{
+	int i, j;
+
+	#pragma omp parallel for private(i, j)
+	for (j = 0; j < N; j++)
+		for (i = 0; i < N; i++)
+			rhs[i + j * N] = (NULL == g) ? 0. : g(i, j, N)/N/N;
+}
+
+
+void fillRHSRows(double *rhs, void (*grow)(double *, int, int), int N)
+{
+	int i, j;
+
+	#pragma omp parallel for private(i, j)
+	for (j = 0; j < N; j++) {
+		grow(rhs + j * N, j, N);
+		for (i = 0; i < N; i++)
+			rhs[i + j * N] = rhs[i + j * N]/N/N;
+	}
+}
+
+
+/* RHS of the row of color c starting at off, as the kernels of the grid
+ * take it */
+static inline const double *rowRHS(const SORGrid *grid, int c, size_t off)
+{
+	return (SOR_RHS_ARRAY == grid->kind) ? grid->rhs[c] + off
+	                                     : &grid->value;
+}
+
+
+/* Row y of color c: the points x with x + y = c (mod 2) */
+static inline double sweepRow(const SORGrid *grid, int c, int y,
+                              double gamma, int N, int track)
+{
+	const size_t off = (size_t) y * grid->ld;
+
+	return grid->rows[track](grid->color[c] + off, grid->color[c] + off,
+	                         grid->color[1 - c] + off,
+	                         rowRHS(grid, c, off), gamma, N, (c + y) % 2,
+	                         track);
+}
+
+
+/* Norm of two parts of the grid from the norms of each, see SORTrack */
+static inline double joinNorms(double a, double b, int track)
+{
+	return (SOR_TRACK_SUM2 == track) ? a + b : fmax(a, b);
+}
+
+
+/* Part [*lo, *hi) of n items owned by the calling thread of the team. The
+ * bands differ by at most one item and stay the same for the whole solve. */
+static void threadBand(size_t n, size_t *lo, size_t *hi)
+{
+	size_t tid = 0, nth = 1;
+
+	#ifdef _OPENMP
+	tid = omp_get_thread_num();
+	nth = omp_get_num_threads();
+	#endif
+	*lo = n * tid / nth;
+	*hi = n * (tid + 1) / nth;
+}
+
+
+/* n arrays of rows x ld doubles, see allocRows() */
+static double *allocBands(size_t ld, int rows, int n, int flags)
+{
+	return (double *) allocRows(ld * sizeof(double), rows, n, flags);
+}
+
+
+/* Each thread zeroes the rows of its band in the sweeps, see
+ * PoissonSOR2DRHS(), in all the arrays, so the first touch puts the pages
+ * next to the thread; the first and last threads also take the boundary
+ * rows. */
+void *allocRows(size_t size, int rows, int n, int flags)
+{
+	size_t align = (size_t) sysconf(_SC_PAGESIZE);
+	const size_t len = size * rows * n;
+	void *p;
+	char *a;
+	int err;
+
+	if (flags & SOR_ALLOC_HUGE)
+		align = SOR_HUGE_PAGE;
+	/* it does not set errno, the callers print it */
+	if ((err = posix_memalign(&p, align, len))) {
+		errno = err;
+		return NULL;
+	}
+	a = (char *) p;
+	#ifdef MADV_HUGEPAGE
+	if (flags & SOR_ALLOC_HUGE)
+		madvise(p, len, MADV_HUGEPAGE);
+	#endif
+
+	if (rows < 3) {
+		memset(a, 0, len);
+		return a;
+	}
+
+	#pragma omp parallel
+	{
+		size_t j0, j1;
+		int k;
+
+		threadBand(rows - 2, &j0, &j1);
+		j0 = (0 == j0) ? 0 : j0 + 1;
+		j1 = ((size_t) rows - 2 == j1) ? (size_t) rows : j1 + 1;
+		for (k = 0; k < n; k++)
+			memset(a + (k * (size_t) rows + j0) * size, 0,
+			       (j1 - j0) * size);
+	}
+
+	return a;
+}
+
+
+/* Points of color c on the interior rows [j0, j1) */
+static double sweepBand(const SORGrid *grid, int c, double gamma, int N,
+                        int track, int j0, int j1)
+{
+	int j;
+	double lnorm = 0;
+
+	for (j = j0; j < j1; j++) /* y loop */
+		lnorm = joinNorms(lnorm, sweepRow(grid, c, j, gamma, N, track),
+		                  track);
+
+	return lnorm;
+}
+
+
+/* All points of color c in the interior of the grid */
+static double sweepColor(const SORGrid *grid, int c, double gamma, int N,
+                         int track)
+{
+	size_t j0, j1;
+	double lmax = 0, lsum = 0, band;
+
+	#pragma omp parallel private(j0, j1, band) reduction(max:lmax) \
+	                     reduction(+:lsum)
+	{
+		threadBand(N - 2, &j0, &j1);
+		band = sweepBand(grid, c, gamma, N, track, j0 + 1, j1 + 1);
+		lmax = fmax(lmax, band);
+		lsum += band;
+	}
+
+	return (SOR_TRACK_SUM2 == track) ? lsum : lmax;
+}
+
+
+/* Temporal blocking: the given number of sweeps in one pass over the grid.
+ *
+ * The sweep s updates the black row y at step y + 4s and the red row y at
+ * step y + 4s + 2. Every row then reads its neighbors after they reached the
+ * same sweep as in the plain order and before they move past it, so the
+ * result is the same as sweeping the whole grid that many times. The rows
+ * touched in one step are independent and only about 4 * sweeps rows are
+ * live at a time, which stay in cache between the sweeps instead of being
+ * streamed from memory once per sweep.
+ *
+ * To be called by all the threads of a parallel region. Returns the norm of
+ * the last sweep over the rows done by the calling thread. */
+static double sweepWavefront(const SORGrid *grid, double gamma, int N,
+                             int sweeps, int track)
+{
+	const int steps = N - 2 + 4 * sweeps - 2;
+	int t, task, s, c, y;
+	double lnorm = 0;
+
+	for (t = 1; t <= steps; t++) {
+		#pragma omp for schedule(static)
+		for (task = 0; task < 2 * sweeps; task++) {
+			s = task / 2;
+			c = task % 2;
+			y = t - 4 * s - 2 * c;
+			if ((y > 0) && (y < N - 1) && (s == sweeps - 1))
+				lnorm = joinNorms(lnorm, sweepRow(grid, c, y, gamma,
+				                  N, track), track);
+			else if ((y > 0) && (y < N - 1))
+				sweepRow(grid, c, y, gamma, N, 0);
 		}
+	}
+
+	return lnorm;
+}
+
+
+/* SOR step of the compact stencil on the rows [j0, j1). A point reads its
+ * eight neighbors, so the points with the same parities of x and y are the
+ * ones independent of each other: the colors are swept in the order
+ * (x even, y even), (x odd, y even), (x even, y odd), (x odd, y odd), with a
+ * barrier after each but the last. To be called by all the threads of a
+ * parallel region, each with its own band. */
+static double sweepCompact(const SORGrid *grid, double gamma, int N,
+                           int track, int j0, int j1)
+{
+	int c, j;
+	double lnorm = 0;
+
+	for (c = 0; c < 4; c++) {
+		/* the rows of parity c / 2; sweepRow() takes the points of
+		 * parity c % 2 as the color (c + j) % 2 */
+		for (j = j0 + (j0 + c / 2) % 2; j < j1; j += 2)
+			lnorm = joinNorms(lnorm, sweepRow(grid, (c + j) % 2, j,
+			                  gamma, N, track), track);
+		if (c < 3) {
+			#pragma omp barrier
+		}
+	}
+
+	return lnorm;
+}
+
+
+/* Symmetric SOR step on the rows [j0, j1): black, red, red, black. The red
+ * points only see black ones, so the two red sweeps are a single sweep with
+ * parameter 1 - (1 - gamma)^2. To be called by all the threads of a
+ * parallel region, each with its own band. */
+static double sweepSSORBand(const SORGrid *grid, double gamma, int N,
+                            int track, int j0, int j1)
+{
+	double lnorm;
+
+	lnorm = sweepBand(grid, 0, gamma, N, track, j0, j1);
+	#pragma omp barrier
+	lnorm = joinNorms(lnorm, sweepBand(grid, 1, gamma * (2. - gamma), N,
+	                                   track, j0, j1), track);
+	#pragma omp barrier
+	lnorm = joinNorms(lnorm, sweepBand(grid, 0, gamma, N, track, j0, j1),
+	                  track);
+
+	return lnorm;
+}
+
+
+/* Symmetric SOR step on the whole grid */
+static double sweepSSOR(const SORGrid *grid, double gamma, int N, int track)
+{
+	size_t j0, j1;
+	double lmax = 0, lsum = 0, band;
+
+	#pragma omp parallel private(j0, j1, band) reduction(max:lmax) \
+	                     reduction(+:lsum)
+	{
+		threadBand(N - 2, &j0, &j1);
+		band = sweepSSORBand(grid, gamma, N, track, j0 + 1, j1 + 1);
+		lmax = fmax(lmax, band);
+		lsum += band;
+	}
+
+	return (SOR_TRACK_SUM2 == track) ? lsum : lmax;
+}
+
+
+/* One Chebyshev step. The eigenvalues of the SSOR step lie in [0, rho], so
+ * it is first extrapolated to G = e SSOR + (1 - e), e = 2 / (2 - rho),
+ * whose eigenvalues lie in [-rho / (2 - rho), rho / (2 - rho)]. With y(k)
+ * the current iterate in sol and cur, and y(k-1) the previous one in prev:
+ *   y(k+1) = y(k-1) + omega (G(y(k)) - y(k-1))
+ * The SSOR step runs in place on sol, which then gets y(k+1). It is also
+ * stored in prev; the caller swaps prev and cur. Only the interior points
+ * of the band are combined, so the boundary values are never written.
+ *
+ * To be called by all the threads of a parallel region, each with its own
+ * band of rows. Returns the norm of the changes made by the SSOR step on
+ * the band. */
+static double sweepChebyshev(const SORGrid *grid, double *sol, double *prev,
+                             const double *cur, double gamma, double e,
+                             double omega, int N, int track, int j0, int j1)
+{
+	size_t n0;
+	double lnorm;
+	int c, j, p;
+
+	lnorm = sweepSSORBand(grid, gamma, N, track, j0, j1);
+	#pragma omp barrier
+
+	/* the other bands are done with the rows of this one now. In the
+	 * split layout, the interior points of parity p of a row are the
+	 * ones from (2 - p) / 2 to (N - p) / 2 of its color. */
+	for (j = j0; j < j1; j++) {
+		if (grid->color[0] == grid->color[1]) {
+			n0 = (size_t) j * N;
+			combineRange(sol, prev, cur, n0 + 1, n0 + N - 1, e, omega);
+			continue;
+		}
+		for (c = 0; c < 2; c++) {
+			p = (c + j) % 2;
+			n0 = (size_t) (grid->color[c] - sol) +
+			     (size_t) j * grid->ld;
+			combineRange(sol, prev, cur, n0 + (2 - p) / 2,
+			             n0 + (N - p) / 2, e, omega);
+		}
+	}
+
+	return lnorm;
+}
+
+
+/* Points [n0, n1) of the Chebyshev step, see sweepChebyshev() */
+static inline void combineRange(double *sol, double *prev, const double *cur,
+                                size_t n0, size_t n1, double e, double omega)
+{
+	size_t n;
+
+	for (n = n0; n < n1; n++) {
+		sol[n] = prev[n] + omega * (e * sol[n] + (1. - e) * cur[n] -
+		                            prev[n]);
+		prev[n] = sol[n];
+	}
+}
+
+
+/* Largest residual / 4 on the rows [j0, j1), in either layout. A
+ * Gauss-Seidel update changes a point by its residual / 4, so each row is
+ * run through the kernel with gamma = 1 into a scratch row of grid->ld
+ * values instead of the grid. */
+static double residualBand(const SORGrid *grid, int N, int j0, int j1,
+                           double *scratch)
+{
+	const size_t ld = grid->ld;
+	int j, c;
+	double lnorm = 0;
+
+	for (j = j0; j < j1; j++)
+		for (c = 0; c < 2; c++)
+			lnorm = fmax(lnorm, grid->rows[SOR_TRACK_MAX](scratch,
+			             grid->color[c] + j * ld,
+			             grid->color[1 - c] + j * ld,
+			             rowRHS(grid, c, j * ld),
+			             1., N, (c + j) % 2, SOR_TRACK_MAX));
+
+	return lnorm;
+}
+
+
+double SSORRadius(double gamma, int N)
+{
+	const double w2 = gamma * (2. - gamma);
+	const double mu_max = cos(M_PI / (N - 1.));
+	const double det = (1. - gamma) * (1. - gamma) * (1. - w2);
+	int k;
+	double mu, tr, disc, lambda, rho = 0;
+
+	/* On the pair of black and red modes of Jacobi eigenvalue mu, the
+	 * black sweep is [[1 - gamma, gamma mu], [0, 1]] and the red one
+	 * [[1, 0], [w2 mu, 1 - w2]]. Black, red, black has trace tr and
+	 * determinant det. */
+	for (k = 0; k <= 256; k++) {
+		mu = mu_max * k / 256.;
+		tr = (1. - gamma) * (1. - gamma) +
+		     gamma * w2 * (2. - gamma) * mu * mu + 1. - w2;
+		disc = tr * tr - 4. * det;
+		lambda = (disc < 0) ? sqrt(det)
+		                    : 0.5 * (fabs(tr) + sqrt(disc));
+		rho = fmax(rho, lambda);
+	}
+
+	return rho;
+}
+
+
+/* Adaptive SOR parameter, after Hageman and Young. Once the error is
+ * dominated by its slowest mode, the norm of a step falls by a constant
+ * ratio lambda per sweep, related to the Jacobi spectral radius mu by
+ *   mu^2 = (lambda + gamma - 1)^2 / (lambda gamma^2)
+ * The estimate of mu is at most the true one, so the new gamma stays
+ * below the optimum 2 / (1 + sqrt(1 - mu^2)). lambda counts as settled
+ * when it moved by less than 1% of 1 - lambda for a few steps, which
+ * needs two norms after each change of gamma. Near the optimum the
+ * settled ratios overshoot gamma - 1, so gamma is only raised when lambda
+ * is above the power-law bound (gamma - 1)^0.65 of Hageman and Young.
+ *
+ * Returns the parameter for the next step. */
+static double adaptGamma(SORAdapt *adapt, double gamma, double norm,
+                         int sweeps)
+{
+	const int settle = 3;
+	double lambda, mu2, next;
+
+	if (0 == norm)
+		return gamma;
+	if (adapt->norm <= 0) {
+		adapt->norm = norm;
+		adapt->ratio = 0;
+		adapt->stable = 0;
+		return gamma;
+	}
+
+	lambda = pow(norm / adapt->norm, 1. / sweeps);
+	adapt->norm = norm;
+	if ((adapt->ratio > 0) &&
+	    (fabs(lambda - adapt->ratio) < 0.01 * (1. - lambda)))
+		adapt->stable++;
+	else
+		adapt->stable = 0;
+	adapt->ratio = lambda;
+
+	if ((adapt->stable < settle) || (lambda >= 1.))
+		return gamma;
+	adapt->stable = 0;
+	if (lambda <= pow(gamma - 1., 0.65))
+		return gamma;
+
+	mu2 = (lambda + gamma - 1.) * (lambda + gamma - 1.) /
+	      (lambda * gamma * gamma);
+	next = 2. / (1. + sqrt(1. - fmin(mu2, 1. - 1e-12)));
+	if (next <= gamma)
+		return gamma;
+
+	adapt->norm = 0;
+	return next;
+}
+
+
+void update(double *f, const double *rhs,
+            double *norm, double gamma, int N, const SORKernels *kern)
+{
+	SORGrid grid;
+	const int track = (NULL != norm);
+	double lnorm;
+
+	grid.color[0] = grid.color[1] = f;
+	grid.rhs[0] = grid.rhs[1] = rhs;
+	grid.ld = N;
+	grid.rows = kern->naturalRHS[SOR_RHS_ARRAY];
+	grid.kind = SOR_RHS_ARRAY;
+
+	/* for all black grid points in the interior of the grid */
+	lnorm = sweepColor(&grid, 0, gamma, N, track);
+	/* for all red grid points, with the new black ones as neighbors */
+	lnorm = fmax(lnorm, sweepColor(&grid, 1, gamma, N, track));
+
+	if (track)
 		*norm = lnorm;
-	} else {
-		/* for all black grid points in the interior of the grid */
-		#pragma omp parallel for private(i,j,k) shared(f,f_old) schedule(static,chunk)
-		for (j = 1; j < N - 1; j++) { /* y loop */
-			k = (j + 1) % 2;
-			for (i = 1 + k; i < N - 1; i += 2) { /* x loop */
-				f[i + j * N] = f_old[i + j * N] +
-				               gamma * (f_old[i-1 +  j    * N] +
-				                        f_old[i+1 +  j    * N] +
-				                        f_old[i   + (j-1) * N] +
-				                        f_old[i   + (j+1) * N] -
-				                        4. * f_old[i  + j * N] -
-				                        g(i, j, N)/N/N) / 4.;
+}
+
+
+void updateSSOR(double *f, const double *rhs,
+                double *norm, double gamma, int N, const SORKernels *kern)
+{
+	SORGrid grid;
+	const int track = (NULL != norm);
+	double lnorm;
+
+	grid.color[0] = grid.color[1] = f;
+	grid.rhs[0] = grid.rhs[1] = rhs;
+	grid.ld = N;
+	grid.rows = kern->naturalRHS[SOR_RHS_ARRAY];
+	grid.kind = SOR_RHS_ARRAY;
+
+	lnorm = sweepSSOR(&grid, gamma, N, track);
+
+	if (track)
+		*norm = lnorm;
+}
+
+
+double residual(double *res, const double *f, const double *rhs, int N)
+{
+	int i, j;
+	double lnorm = 0;
+
+	#pragma omp parallel for private(i) reduction(max:lnorm)
+	for (j = 0; j < N; j++) {
+		for (i = 0; i < N; i++) {
+			if ((0 == i) || (0 == j) || (N - 1 == i) || (N - 1 == j)) {
+				res[i + j * N] = 0.;
+				continue;
 			}
+			res[i + j * N] = rhs[i + j * N] -
+			                 (f[i-1 +  j    * N] +
+			                  f[i+1 +  j    * N] +
+			                  f[i   + (j-1) * N] +
+			                  f[i   + (j+1) * N] -
+			                  4. * f[i + j * N]);
+			lnorm = fmax(lnorm, fabs(res[i + j * N]));
 		}
+	}
 
-		/* for all red grid points in the interior of the grid */
-		#pragma omp parallel for private(i,j,k) shared(f,f_old) schedule(static,chunk)
-		for (j = 1; j < N - 1; j++) { /* y loop */
-			k = (j) % 2;
-			for (i = 1 + k; i < N - 1; i += 2) { /* x loop */
-				f[i + j * N] = f_old[i + j * N] +
-				               gamma * (f[i-1 +  j    * N] +
-				                        f[i+1 +  j    * N] +
-				                        f[i   + (j-1) * N] +
-				                        f[i   + (j+1) * N] -
-				                        4. * f_old[i  + j * N] -
-				                        g(i, j, N)/N/N) / 4.;
-			}
+	return lnorm;
+}
+
+
+/* Rows [j0, j1) of the grid into f, in the natural layout */
+static void copyRows(const SORGrid *grid, double *f, int N, size_t j0,
+                     size_t j1)
+{
+	size_t i, j;
+
+	if (grid->color[0] == grid->color[1]) {
+		memcpy(f + j0 * N, grid->color[0] + j0 * N,
+		       (j1 - j0) * N * sizeof(double));
+		return;
+	}
+
+	for (j = j0; j < j1; j++)
+		for (i = 0; i < (size_t) N; i++)
+			f[i + j * N] = grid->color[(i + j) % 2][i / 2 +
+			                                        j * grid->ld];
+}
+
+
+void toRedBlack(const double *f, double *red, double *black, int N)
+{
+	const int W = (N + 1) / 2;
+	int i, j;
+
+	#pragma omp parallel for private(i, j)
+	for (j = 0; j < N; j++) {
+		for (i = 0; i < N; i++) {
+			if ((i + j) % 2 == 0)
+				black[i / 2 + j * W] = f[i + j * N];
+			else
+				red[i / 2 + j * W] = f[i + j * N];
 		}
 	}
 }
 
 
+void fromRedBlack(double *f, const double *red, const double *black, int N)
+{
+	const int W = (N + 1) / 2;
+	int i, j;
+
+	#pragma omp parallel for private(i, j)
+	for (j = 0; j < N; j++) {
+		for (i = 0; i < N; i++) {
+			if ((i + j) % 2 == 0)
+				f[i + j * N] = black[i / 2 + j * W];
+			else
+				f[i + j * N] = red[i / 2 + j * W];
+		}
+	}
+}
+
+
+void updateRedBlack(double *red, double *black,
+                    const double *rhs_red, const double *rhs_black,
+                    double *norm, double gamma, int N,
+                    const SORKernels *kern)
+{
+	SORGrid grid;
+	const int track = (NULL != norm);
+	double lnorm;
+
+	grid.color[0] = black;
+	grid.color[1] = red;
+	grid.rhs[0] = rhs_black;
+	grid.rhs[1] = rhs_red;
+	grid.ld = (N + 1) / 2;
+	grid.rows = kern->redblackRHS[SOR_RHS_ARRAY];
+	grid.kind = SOR_RHS_ARRAY;
+
+	lnorm = sweepColor(&grid, 0, gamma, N, track);
+	lnorm = fmax(lnorm, sweepColor(&grid, 1, gamma, N, track));
+
+	if (track)
+		*norm = lnorm;
+}
+
+
 int writeToFile(const char *fname, int N, double *f, double (*g)(int, int, int))
 {
 	int i, j;
@@ -178,3 +1256,223 @@ int writeToFile(const char *fname, int N, double *f, double (*g)(int, int, int))
 
 	return 0;
 }
+
+
+int writeToFileBin(const char *fname, int N, const double *f,
+                   const SORStats *stats)
+{
+	SORFileHeader head;
+	FILE *fp = NULL;
+	char filen[256];
+	const size_t n = (size_t) N * N;
+	int ret = 0;
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, SOR_FILE_MAGIC, sizeof(head.magic));
+	head.version = SOR_FILE_VERSION;
+	head.N = N;
+	head.dtype = SOR_DTYPE_FLOAT64;
+	head.layout = SOR_LAYOUT_NATURAL;
+	if (NULL != stats) {
+		head.sweeps = stats->sweeps;
+		head.interval = stats->interval;
+		head.norm = stats->norm;
+	}
+
+	snprintf(filen, sizeof(filen), "%s%s", fname, ".bin");
+
+	if (!(fp = fopen(filen, "wb"))) {
+		perror("Unable to write files");
+		return -1;
+	}
+
+	/* a write this large skips the buffer of fp */
+	if ((fwrite(&head, sizeof(head), 1, fp) != 1) ||
+	    (fwrite(f, sizeof(double), n, fp) != n)) {
+		perror("Unable to write files");
+		ret = -1;
+	}
+
+	if (fclose(fp)) {
+		perror("Unable to write files");
+		ret = -1;
+	}
+
+	return ret;
+}
+
+
+int mapSolution(SORFileMap *m, const char *path)
+{
+	struct stat st;
+	int fd;
+	void *map;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		perror("Unable to read file");
+		return -1;
+	}
+	if (fstat(fd, &st) < 0) {
+		perror("Unable to read file");
+		close(fd);
+		return -1;
+	}
+	if ((size_t) st.st_size < sizeof(SORFileHeader)) {
+		close(fd);
+		return 2;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	/* the mapping keeps the file open */
+	close(fd);
+	if (MAP_FAILED == map) {
+		perror("Unable to map file");
+		return -1;
+	}
+
+	memcpy(&m->head, map, sizeof(m->head));
+	if (memcmp(m->head.magic, SOR_FILE_MAGIC, sizeof(m->head.magic)) ||
+	    (SOR_FILE_VERSION != m->head.version) ||
+	    (SOR_DTYPE_FLOAT64 != m->head.dtype) ||
+	    (SOR_LAYOUT_NATURAL != m->head.layout) || (m->head.N < 1) ||
+	    ((size_t) st.st_size < sizeof(SORFileHeader) +
+	     (size_t) m->head.N * m->head.N * sizeof(double))) {
+		munmap(map, st.st_size);
+		return 2;
+	}
+
+	m->map = map;
+	m->len = st.st_size;
+	m->f = (const double *) ((const char *) map + sizeof(SORFileHeader));
+
+	return 0;
+}
+
+
+void unmapSolution(SORFileMap *m)
+{
+	if (NULL != m->map)
+		munmap(m->map, m->len);
+	m->map = NULL;
+	m->f = NULL;
+	m->len = 0;
+}
+
+
+int readFromFile(const char *path, int N, double *f, SORStats *stats)
+{
+	SORFileMap m;
+	double *text = NULL;
+	const double *src;
+	int ret, M;
+
+	if (NULL == f)
+		return 1;
+
+	memset(&m, 0, sizeof(m));
+	ret = mapSolution(&m, path);
+	if (0 == ret) {
+		src = m.f;
+		M = m.head.N;
+	} else if (2 == ret) {
+		/* not binary, maybe the text of writeToFile() */
+		if (!(text = readText(path, &M)))
+			return 2;
+		src = text;
+		memset(&m.head, 0, sizeof(m.head));
+	} else {
+		return ret;
+	}
+
+	if (M < 2) {
+		/* nothing to interpolate from */
+		unmapSolution(&m);
+		free(text);
+		return 2;
+	}
+
+	interpolate(f, N, src, M);
+	if (NULL != stats) {
+		stats->sweeps = m.head.sweeps;
+		stats->interval = m.head.interval;
+		stats->norm = m.head.norm;
+	}
+
+	unmapSolution(&m);
+	free(text);
+
+	return 0;
+}
+
+
+/* Values of a file of writeToFile(), or NULL if it is not one */
+static double *readText(const char *path, int *M)
+{
+	FILE *fp;
+	double *src = NULL;
+	size_t n, k;
+
+	if (!(fp = fopen(path, "r"))) {
+		perror("Unable to read file");
+		return NULL;
+	}
+
+	if ((1 != fscanf(fp, "# N = %d", M)) || (*M < 1)) {
+		fclose(fp);
+		return NULL;
+	}
+
+	n = (size_t) *M * *M;
+	if (!(src = (double *) malloc(n * sizeof(double)))) {
+		perror("File array allocation error:");
+		fclose(fp);
+		return NULL;
+	}
+	for (k = 0; k < n; k++)
+		if (1 != fscanf(fp, "%lf", src + k)) {
+			free(src);
+			src = NULL;
+			break;
+		}
+
+	fclose(fp);
+	return src;
+}
+
+
+/* Interior of the N x N grid f from the M x M grid src, M > 1, bilinear.
+ * Point x of f is at x (M - 1) / (N - 1) in src. */
+static void interpolate(double *f, int N, const double *src, int M)
+{
+	const double h = (M - 1.) / (N - 1.);
+	double r, s;
+	int i, j, a, b;
+
+	if (M == N) {
+		for (j = 1; j < N - 1; j++)
+			memcpy(f + 1 + (size_t) j * N, src + 1 + (size_t) j * N,
+			       (N - 2) * sizeof(double));
+		return;
+	}
+
+	#pragma omp parallel for private(i, j, a, b, r, s)
+	for (j = 1; j < N - 1; j++) {
+		/* the cell [b, b + 1] of src holding the point, and the
+		 * position in it */
+		b = (int) (j * h);
+		if (b > M - 2)
+			b = M - 2;
+		s = j * h - b;
+		for (i = 1; i < N - 1; i++) {
+			a = (int) (i * h);
+			if (a > M - 2)
+				a = M - 2;
+			r = i * h - a;
+			f[i + (size_t) j * N] =
+				(1. - s) * ((1. - r) * src[a + (size_t) b * M] +
+				            r * src[a + 1 + (size_t) b * M]) +
+				s * ((1. - r) * src[a + (size_t) (b + 1) * M] +
+				     r * src[a + 1 + (size_t) (b + 1) * M]);
+		}
+	}
+}
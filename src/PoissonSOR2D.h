@@ -11,6 +11,209 @@
 #define POISSONSOR2D_H_INCLUDED
 
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "PoissonSOR2D_SIMD.h"
+
+
+/** @brief Storage of the grid used during the sweeps. */
+typedef enum {
+	SOR_LAYOUT_NATURAL = 0, /**< f[x + y * N], as given by the user */
+	SOR_LAYOUT_REDBLACK     /**< red and black points in two half-grids */
+} SORLayout;
+
+
+/** @brief Iteration run by the CPU solver. */
+typedef enum {
+	SOR_ACCEL_NONE = 0, /**< plain red-black SOR */
+	SOR_ACCEL_CHEBYSHEV /**< symmetric SOR with Chebyshev acceleration */
+} SORAccel;
+
+
+/** @brief Discretization of the Laplacian solved by the CPU solver.
+ *
+ * The 5-point stencil is second order: the error of the discrete solution
+ * falls as h^2. The compact 9-point stencil (Mehrstellen) weighs the four
+ * sides by 4 and the four corners by 1, and with the RHS corrected by its
+ * own Laplacian,
+ * @f[ 4 \sum_{sides} f + \sum_{corners} f - 20 f =
+ *     6 h^2 \left(g + \frac{h^2}{12} \Delta g\right) @f]
+ * it is fourth order, so the same error is reached on a much coarser grid.
+ * A point reads its eight neighbors, and the sweeps go through four colors,
+ * the parities of x and of y, instead of two.
+ */
+typedef enum {
+	SOR_STENCIL_5 = 0, /**< 5-point stencil, second order */
+	SOR_STENCIL_9      /**< compact 9-point stencil, fourth order */
+} SORStencil;
+
+
+/** @brief Norm used to decide convergence. */
+typedef enum {
+	SOR_NORM_MAX = 0, /**< largest change of a point in the last step */
+	SOR_NORM_L2,      /**< root mean square change in the last step */
+	SOR_NORM_RESIDUAL /**< largest residual / 4, see residual() */
+} SORNorm;
+
+
+/** @brief When and how the CPU solver checks for convergence.
+ *
+ * Only the steps that end at a check compute a norm, the others run the
+ * kernels without it, and the progress line is only printed at checks.
+ * The first check is after every sweeps, and after each check the interval
+ * is multiplied by growth. The solve can then run up to growth times more
+ * sweeps than needed, in exchange for fewer checks.
+ */
+typedef struct {
+	int every;     /**< sweeps before the first check, at least 1 */
+	double growth; /**< growth of the interval, 1 for a fixed one */
+	SORNorm norm;  /**< norm compared with prec */
+} SORCheck;
+
+
+/** @brief What the CPU solver did, filled at the end of the solve. */
+typedef struct {
+	int sweeps;   /**< sweeps run */
+	int checks;   /**< convergence checks made */
+	int interval; /**< sweeps between the last two checks */
+	double norm;  /**< norm at the last check */
+	double time;  /**< seconds of the solve */
+} SORStats;
+
+
+/** @brief Progress line of a solver.
+ *
+ * Called at the first convergence check past each multiple of 100 sweeps
+ * and at the last one, with the sweeps done, the norm and prec, from one
+ * thread of the solve while the others wait.
+ */
+typedef void (*SORLog)(void *data, /**< [in] SOROptions::logdata */
+                       int sweeps, /**< [in] sweeps done */
+                       double norm, /**< [in] norm of the check */
+                       double prec /**< [in] desired precision */);
+
+
+/** @brief Background writer of snapshots, see PoissonSOR2D_Writer.h. */
+typedef struct SORWriter SORWriter;
+
+
+/** @brief Telemetry of the solves, see PoissonSOR2D_Telemetry.h. */
+typedef struct SORTelemetry SORTelemetry;
+
+
+/** @brief Tunables of the CPU solver.
+ *
+ * Call initSOROptions() before setting the fields, so new fields get their
+ * default values. Passing NULL instead of options means defaults.
+ */
+typedef struct {
+	SORLayout layout; /**< storage of the grid during the sweeps */
+	SORKernel kernel; /**< instruction set of the sweeps */
+	/** sweeps applied in one pass over the grid (temporal blocking).
+	 * With more than 1, the sweeps advance as a wavefront over the rows so
+	 * each row is loaded into cache once per pass instead of once per
+	 * sweep. The result is the same as with 1, but convergence is only
+	 * checked after each pass. */
+	int wavefront;
+	/** iteration to run. With SOR_ACCEL_CHEBYSHEV each step is a
+	 * symmetric SOR step of parameter gamma, see updateSSOR(), combined
+	 * with the previous iterate by the Chebyshev semi-iteration. The
+	 * spectral radius it needs is SSORRadius(). wavefront is ignored.
+	 * With the red-black ordering it takes about as many steps as SOR, see
+	 * SSORParamCheb(), and each step costs three half sweeps and the
+	 * combination, so it is slower than plain SOR. */
+	SORAccel accel;
+	/** discretization of the equation. With SOR_STENCIL_9 the solve runs
+	 * plain SOR of the compact stencil on the natural layout, for which
+	 * gamma is best from SORParam9(): layout, wavefront and accel are
+	 * ignored. The RHS is given as for the 5-point stencil and corrected
+	 * in the workspace, and SOR_NORM_RESIDUAL is the residual of the
+	 * compact equation over 20. */
+	SORStencil stencil;
+	/** with 1, the SOR parameter is estimated during the solve. The solve
+	 * starts from gamma, 1 for Gauss-Seidel sweeps, and raises the
+	 * parameter each time the ratio of successive norms settles, from the
+	 * Jacobi spectral radius it implies. A gamma above the optimum is
+	 * kept. Not used with SOR_ACCEL_CHEBYSHEV. */
+	int adaptive;
+	/** when and how to check for convergence. The adaptive parameter is
+	 * updated at checks only, from the ratio per sweep of the norms. */
+	SORCheck check;
+	/** where to store what the solve did, or NULL */
+	SORStats *stats;
+	/** writer of snapshots of the grid, or NULL. The solve hands it a
+	 * copy of the grid each time the sweeps pass a multiple of snapshot
+	 * and goes on while the copy is written, see openSORWriter(). */
+	SORWriter *writer;
+	/** sweeps between snapshots */
+	int snapshot;
+	/** sweeps already done on f, for a restart from a file read by
+	 * readFromFile(). The sweeps are counted from start, so tmax, the
+	 * checks, the snapshots and SORStats::sweeps include them. */
+	int start;
+	/** stats of the solve before the restart, from readFromFile(), or
+	 * NULL. The checks go on from its interval grown by check.growth
+	 * instead of from check.every, and its norm stands until the first
+	 * check. A norm below prec does not end the solve before a check. The
+	 * adaptive parameter is estimated again from gamma. */
+	const SORStats *resume;
+	/** where to record the time and norm of each step, or NULL. Only
+	 * used when built with SOR_TELEMETRY, see openSORTelemetry(). */
+	SORTelemetry *telemetry;
+	/** flags of the allocation of the workspace, see allocGrid() */
+	int alloc;
+	/** progress lines, printSORLog() by default, or NULL for none */
+	SORLog log;
+	/** first argument of log */
+	void *logdata;
+} SOROptions;
+
+
+/** @brief Set all solver options to their default values. */
+void initSOROptions(SOROptions *opts /**< [out] options to initialize */);
+
+
+/** @brief Default SOROptions::log, prints "t, norm, prec:" lines. */
+void printSORLog(void *data, int sweeps, double norm, double prec);
+
+
+/** @brief Flag of allocGrid(): ask for transparent huge pages. */
+#define SOR_ALLOC_HUGE 1
+
+
+/** @brief Allocate a grid for the CPU solvers.
+ *
+ * Returns N x N doubles set to 0, aligned to a page, or to 2 MB with
+ * SOR_ALLOC_HUGE. The zeros are written in a parallel region by the same
+ * threads that sweep the rows in PoissonSOR2DRHS(), each its own band, so
+ * on a NUMA machine the pages of a band are placed on the node of the
+ * thread that sweeps it. This needs the threads pinned, e.g. with
+ * OMP_PROC_BIND=close, and the same number of threads in the solve.
+ *
+ * The grid is released with free().
+ *
+ * @return the grid, or NULL on memory error
+ */
+double *allocGrid(int N, /**< [in] grid size in each dimension */
+                  int flags /**< [in] 0 or SOR_ALLOC_HUGE */);
+
+
+/** @brief Allocate the workspace of a solver.
+ *
+ * As allocGrid(), for n arrays of rows x size bytes in one block, such as
+ * several grids at once, grids of other types or interleaved problems. Row
+ * j of each array is zeroed by the thread that sweeps row j of a grid of
+ * rows rows.
+ *
+ * The block is released with free().
+ *
+ * @return the arrays, or NULL on memory error
+ */
+void *allocRows(size_t size, /**< [in] bytes of a row */
+                int rows,    /**< [in] rows of each array */
+                int n,       /**< [in] number of arrays */
+                int flags    /**< [in] 0 or SOR_ALLOC_HUGE */);
+
 
 /** @brief Solver of Poisson Equation.
  *
@@ -40,6 +243,113 @@ int PoissonSOR2D(double *f, /**< [in, out] numerical result */
                  double prec /**< [in] desired precision */);
 
 
+/** @brief Solver of Poisson Equation with a precomputed RHS.
+ *
+ * Same as PoissonSOR2D(), but the RHS is given as an array of size N^2
+ * already scaled by the grid spacing, rhs[x + y * N] = g(x, y, N) / N^2.
+ * See fillRHS() and fillRHSRows().
+ *
+ * Use this when solving several times with the same RHS, or when g is
+ * expensive: the sweeps only load rhs and never call back to the user.
+ *
+ * With opts->layout = SOR_LAYOUT_REDBLACK, f and rhs are converted to the
+ * split red-black storage on entry and f is converted back on exit. See
+ * toRedBlack().
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonSOR2DRHS(double *f, /**< [in, out] numerical result */
+                    const double *rhs, /**< [in] scaled RHS of Poisson Eq */
+                    double gamma, /**< [in] SOR parameter */
+                    int N, /**< [in] number of grid points in each dimension */
+                    int tmax, /**< [in] maximum number of iterations */
+                    double prec, /**< [in] desired precision */
+                    const SOROptions *opts /**< [in] options, or NULL */);
+
+
+/** @brief CPU SOR solver kept between solves.
+ *
+ * For many solves of the same size and options, a SORSolver allocates the
+ * workspace of PoissonSOR2DRHS() once and keeps it, with its own copy of
+ * the RHS, so each solve only runs the sweeps. The OpenMP threads are kept
+ * by the runtime from one parallel region to the next anyway.
+ */
+typedef struct SORSolver SORSolver;
+
+
+/** @brief Create a solver of grid size N.
+ *
+ * The options are copied; opts->stats, if set, is filled after each solve
+ * as with PoissonSOR2DRHS(). Set the RHS with setSORSolverRHS() before the
+ * first solve.
+ *
+ * @return the solver, or NULL on memory error
+ */
+SORSolver *openSORSolver(int N, /**< [in] grid size in each dimension */
+                         double gamma, /**< [in] SOR parameter */
+                         const SOROptions *opts /**< [in] options, or NULL */);
+
+
+/** @brief Copy the RHS into the solver, for all the next solves.
+ *
+ * @return
+ * * 0 on success
+ * * 1 on s or rhs not allocated
+ */
+int setSORSolverRHS(SORSolver *s, /**< [in, out] solver */
+                    const double *rhs /**< [in] scaled RHS, N^2 values */);
+
+
+/** @brief Solve for the RHS of the solver.
+ *
+ * Same as PoissonSOR2DRHS() with the RHS, parameter and options of the
+ * solver. Allocates nothing unless the number of OpenMP threads grew since
+ * the last solve.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on s or f not allocated, or no RHS set
+ */
+int solveSORSolver(SORSolver *s, /**< [in, out] solver */
+                   double *f, /**< [in, out] numerical result */
+                   int tmax, /**< [in] maximum number of iterations */
+                   double prec /**< [in] desired precision */);
+
+
+/** @brief What the last solve did. */
+void getSORSolverStats(const SORSolver *s, /**< [in] solver */
+                       SORStats *stats /**< [out] stats of the last solve */);
+
+
+/** @brief Free a solver. */
+void closeSORSolver(SORSolver *s /**< [in] solver, or NULL */);
+
+
+/** @brief Evaluate the RHS of Poisson Equation on the grid.
+ *
+ * Fills rhs[x + y * N] with g(x, y, N) / N^2, the form used by
+ * PoissonSOR2DRHS(). g is called once per grid point.
+ */
+void fillRHS(double *rhs, /**< [out] scaled RHS, size N^2 */
+             double (*g)(int, int, int), /**< [in] RHS of Poisson Eq */
+             int N /**< [in] grid size in each dimension */);
+
+
+/** @brief Evaluate the RHS of Poisson Equation one row at a time.
+ *
+ * Same as fillRHS(), but grow(row, y, N) fills the N values of g on the
+ * row y at once. This lets the caller vectorize g or reuse work along a
+ * row. The values are scaled by 1 / N^2 afterwards.
+ */
+void fillRHSRows(double *rhs, /**< [out] scaled RHS, size N^2 */
+                 void (*grow)(double *, int, int), /**< [in] row of RHS */
+                 int N /**< [in] grid size in each dimension */);
+
+
 /** @brief Get optimal parameter for SOR.
  *
  * According to @cite Yang2009325, the optimal SOR parameter is
@@ -54,14 +364,128 @@ static inline double SORParamSin(int N /**< [in] grid size in one dimension */)
 }
 
 
+/** @brief Get the SOR parameter for the compact 9-point stencil.
+ *
+ * The Jacobi iteration of the compact stencil has the spectral radius
+ * @f[ \mu = \frac{4 \cos(\pi h) + \cos^2(\pi h)}{5} @f]
+ * with @f$ h = \frac{1}{N - 1} @f$, which is put in the formula of Young,
+ * @f$ \omega = \frac{2}{1 + \sqrt{1 - \mu^2}} @f$. The four-color
+ * ordering is not consistently ordered, so this is an estimate, but the
+ * sweeps stay within about 10% of those of the best parameter.
+ *
+ * @return SOR parameter
+ */
+static inline double SORParam9(int N /**< [in] grid size in one dimension */)
+{
+	const double c = cos(M_PI / (N - 1.));
+	const double mu = (4. * c + c * c) / 5.;
+
+	return 2. / (1. + sqrt(1. - mu * mu));
+}
+
+
+/** @brief Parameter of the symmetric SOR step with Chebyshev acceleration.
+ *
+ * With the red-black ordering the symmetric SOR step is close to a
+ * Gauss-Seidel sweep for any omega, and the Chebyshev iteration converges
+ * in about as many steps as SOR with SORParamSin(). A mild over-relaxation
+ * saves about 10% of the steps; the count grows slowly away from it.
+ *
+ * @return SSOR parameter
+ */
+static inline double SSORParamCheb(int N /**< [in] grid size in one dimension */)
+{
+	(void) N;
+	return 1.2;
+}
+
+
+/** @brief Spectral radius of the symmetric SOR step.
+ *
+ * Radius of the iteration matrix of updateSSOR() with parameter gamma on a
+ * grid of N points, from the Jacobi eigenvalues
+ * @f$ \mu \le \cos(\pi h) @f$, @f$ h = \frac{1}{N - 1} @f$. With the
+ * red-black ordering every black and red pair of modes is independent, so
+ * the radius is the largest over mu of the radius of a 2x2 matrix. For
+ * gamma = 1 it is @f$ \cos^2(\pi h) @f$.
+ *
+ * @return spectral radius
+ */
+double SSORRadius(double gamma, /**< [in] SSOR parameter */
+                  int N /**< [in] grid size in one dimension */);
+
+
 /** @brief SOR Itself. Not to be called by user.
  *
- * This function does one step of SOR. The new solution is stored in f.
+ * This function does one step of SOR in place: first all black points, then
+ * all red points with the new black values as neighbors. The largest change
+ * of a point is stored in norm if it is not NULL. Rows are updated by the
+ * kernels in kern, see selectSORKernels().
  *
  * implementation according to @cite berkeley
  */
-void update(double *f, double *f_old, double (*g)(int, int, int),
-            double *norm, double gamma, int N);
+void update(double *f, const double *rhs,
+            double *norm, double gamma, int N, const SORKernels *kern);
+
+
+/** @brief Symmetric SOR step. Not to be called by user.
+ *
+ * Sweeps the black points, the red points, then the red points again and
+ * the black points again, so the step is the same read forwards and
+ * backwards. This makes it a symmetric operator, usable as a
+ * preconditioner for conjugate gradients. The two red sweeps are done as
+ * one, so the step costs 3 color sweeps. Otherwise the same as update().
+ */
+void updateSSOR(double *f, const double *rhs,
+                double *norm, double gamma, int N, const SORKernels *kern);
+
+
+/** @brief Residual of the discrete equation. Not to be called by user.
+ *
+ * res = rhs - (f(x-1, y) + f(x+1, y) + f(x, y-1) + f(x, y+1) - 4 f(x, y))
+ * in the interior and 0 on the boundary. A sweep of update() with
+ * gamma = 1 changes a point by res / 4.
+ *
+ * @return largest |res|
+ */
+double residual(double *res, const double *f, const double *rhs, int N);
+
+
+/** @brief Split a grid into its red and black points.
+ *
+ * Point (x, y) is black when x + y is even and red otherwise. Each color is
+ * stored row by row in its own half-grid of N rows and W = (N + 1) / 2
+ * columns, at index x / 2 + y * W. The left and right neighbors of a point
+ * are then consecutive in the half-grid of the other color, so the sweeps
+ * run with unit stride and every loaded cache line is used.
+ *
+ * red and black must hold N * W values each. Boundary points are copied
+ * too.
+ */
+void toRedBlack(const double *f, /**< [in] grid in natural layout */
+                double *red, /**< [out] red half-grid */
+                double *black, /**< [out] black half-grid */
+                int N /**< [in] grid size in each dimension */);
+
+
+/** @brief Merge red and black half-grids back into a grid.
+ *
+ * Inverse of toRedBlack().
+ */
+void fromRedBlack(double *f, /**< [out] grid in natural layout */
+                  const double *red, /**< [in] red half-grid */
+                  const double *black, /**< [in] black half-grid */
+                  int N /**< [in] grid size in each dimension */);
+
+
+/** @brief SOR Itself on the split red-black layout. Not to be called by user.
+ *
+ * Same as update(), with the grid stored as given by toRedBlack().
+ */
+void updateRedBlack(double *red, double *black,
+                    const double *rhs_red, const double *rhs_black,
+                    double *norm, double gamma, int N,
+                    const SORKernels *kern);
 
 
 /** @brief Write solution to file.
@@ -79,4 +503,108 @@ int writeToFile(const char *fname, /**< [in] path to files */
 		int N, /**< [in] grid size in each dimension */
 		double *f, /**< [in] solution array */
 		double (*g)(int, int, int) /**< [in] RHS of Poisson Eq.*/);
+
+
+/** @brief Type of the values in a binary solution file. */
+typedef enum {
+	SOR_DTYPE_FLOAT64 = 0, /**< double, in the byte order of the writer */
+	SOR_DTYPE_FLOAT32      /**< float, in the byte order of the writer */
+} SORDType;
+
+
+/** @brief Magic bytes at the start of a binary solution file. */
+#define SOR_FILE_MAGIC "SOR2DBIN"
+/** @brief Version of the binary solution file format. */
+#define SOR_FILE_VERSION 1
+
+
+/** @brief Header of a binary solution file, see writeToFileBin().
+ *
+ * The header is 64 bytes long and the N x N values follow it, so the data
+ * starts aligned to 64 bytes in a mapping of the file. All fields are in
+ * the byte order of the writer; a reader on the other byte order sees a
+ * wrong version.
+ */
+typedef struct {
+	char magic[8];    /**< SOR_FILE_MAGIC, not NUL terminated */
+	int32_t version;  /**< SOR_FILE_VERSION */
+	int32_t N;        /**< grid size in each dimension */
+	int32_t dtype;    /**< type of the values, see SORDType */
+	int32_t layout;   /**< order of the values, see SORLayout */
+	int32_t sweeps;   /**< sweeps of the solve, 0 if unknown */
+	int32_t interval; /**< sweeps between the last two checks, 0 if unknown */
+	double norm;      /**< norm at the last check, 0 if unknown */
+	char pad[24];     /**< 0 */
+} SORFileHeader;
+
+
+/** @brief Binary solution file mapped in memory, see mapSolution(). */
+typedef struct {
+	SORFileHeader head; /**< copy of the header */
+	const double *f;    /**< the N x N values, f[x + y * N], in the map */
+	void *map;          /**< start of the mapping */
+	size_t len;         /**< length of the mapping */
+} SORFileMap;
+
+
+/** @brief Write solution to a binary file.
+ *
+ * Write solution to Poisson Equation to file "fname.bin": a SORFileHeader
+ * followed by the N x N values of f as doubles, f[x + y * N], with one
+ * write for the whole grid. Unlike writeToFile() there is no conversion to
+ * text, and the file can be read without copies by mapSolution() or, in
+ * Python, by numpy.memmap with an offset of 64 bytes.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on error while opening or writing the file
+ */
+int writeToFileBin(const char *fname, /**< [in] path to file, without .bin */
+                   int N, /**< [in] grid size in each dimension */
+                   const double *f, /**< [in] solution array */
+                   const SORStats *stats /**< [in] sweeps and norm, or NULL */);
+
+
+/** @brief Map a binary solution file in memory.
+ *
+ * Maps a file written by writeToFileBin() read-only and checks its header.
+ * The values are not copied: m->f points into the mapping, which stays
+ * valid until unmapSolution().
+ *
+ * @return
+ * * 0 on success
+ * * -1 on error while opening or mapping the file
+ * * 2 on a file that is not a binary solution file of doubles
+ */
+int mapSolution(SORFileMap *m, /**< [out] mapped file */
+                const char *path /**< [in] full path of the file */);
+
+
+/** @brief Unmap a file mapped by mapSolution(). */
+void unmapSolution(SORFileMap *m /**< [in, out] mapped file */);
+
+
+/** @brief Read a solution from a file, for a restart or a warm start.
+ *
+ * Reads a file written by writeToFileBin() or writeToFile() into the
+ * interior points of f, which is N x N. The boundary values of f are kept,
+ * so they must be set before. If the file has another grid size, its
+ * values are interpolated bilinearly onto the grid of f, both grids
+ * covering the same square.
+ *
+ * If stats is not NULL, stats->sweeps, stats->interval and stats->norm get
+ * the values in the header of a binary file, or 0 for a text file. Pass
+ * stats->sweeps as SOROptions::start to resume the count of sweeps, and
+ * stats as SOROptions::resume to resume the checks.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on error while opening or reading the file
+ * * 1 on f not allocated
+ * * 2 on a file that is not a solution file
+ */
+int readFromFile(const char *path, /**< [in] full path of the file */
+                 int N, /**< [in] grid size in each dimension */
+                 double *f, /**< [in, out] grid to fill */
+                 SORStats *stats /**< [out] sweeps and norm, or NULL */);
 #endif
@@ -0,0 +1,264 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves many Poisson equations in 2D with Dirichlet's condition and
+ * the same grid size together, using SOR.
+ *
+ */
+
+
+#include "PoissonSOR2D_Batch.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+static inline void updatePoint(double *v, const double *r, size_t B,
+                               size_t NB, int nact, double gamma,
+                               double *lnorm, int track);
+static inline void swapLanes(double *v, double *r, const int *move,
+                             int nmove);
+static double seconds(const struct timespec *t0);
+
+
+int PoissonSOR2DBatch(double **f, const double **rhs, int B, double gamma,
+                      int N, int tmax, double prec, const SOROptions *opts,
+                      SORStats *stats)
+{
+	SOROptions defaults;
+	struct timespec t0;
+	double *F, *R, *work, *norm, lmax;
+	const size_t n = (size_t) N * N;
+	/* norms of one thread, a whole number of cache lines */
+	const int ld = (B + 7) / 8 * 8;
+	int *id, *move, nthreads = 1, nact = B, checks = 0, interval = 0;
+	int last = 0, printed = 0, nmove = 0, b, tdone = 0;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+	for (b = 0; b < B; b++)
+		if ((NULL == f[b]) || (NULL == rhs[b]))
+			return 1;
+
+	if (NULL == opts) {
+		initSOROptions(&defaults);
+		opts = &defaults;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+	#endif
+	/* F and R, the rows placed by the threads that sweep them */
+	F = (double *) allocRows((size_t) N * B * sizeof(double), N, 2,
+	                         opts->alloc);
+	work = (double *) malloc((nthreads + 1) * ld * sizeof(double));
+	id = (int *) malloc(3 * B * sizeof(int));
+	if ((NULL == F) || (NULL == work) || (NULL == id)) {
+		perror("Batch arrays allocation error:");
+		free(F);
+		free(work);
+		free(id);
+		return -1;
+	}
+	/* pairs of lanes to exchange at a check */
+	move = id + B;
+	R = F + n * B;
+	/* lane b holds problem id[b]; the active ones are the first nact */
+	norm = work + nthreads * ld;
+	/* a smaller team leaves some rows of norms unused */
+	memset(work, 0, nthreads * ld * sizeof(double));
+	for (b = 0; b < B; b++)
+		id[b] = b;
+
+	#pragma omp parallel private(b)
+	{
+		size_t k;
+		int tid = 0, t = 0, next, track, c, x, y;
+		double every, *lnorm;
+
+		#ifdef _OPENMP
+		tid = omp_get_thread_num();
+		#endif
+		lnorm = work + tid * ld;
+
+		#pragma omp for
+		for (k = 0; k < n; k++)
+			for (b = 0; b < B; b++) {
+				F[k * B + b] = f[b][k];
+				R[k * B + b] = rhs[b][k];
+			}
+
+		every = (opts->check.every > 1) ? opts->check.every : 1;
+		next = (every < tmax) ? (int) every : tmax;
+
+		/* nact only changes in the single below, between barriers */
+		while ((t < tmax) && (nact > 0)) {
+			track = (t + 1 == next) ? SOR_TRACK_MAX : SOR_TRACK_NONE;
+			for (b = 0; b < nact; b++)
+				lnorm[b] = 0.;
+
+			for (c = 0; c < 2; c++) {
+				#pragma omp for
+				for (y = 1; y < N - 1; y++)
+					for (x = 2 - (c + y) % 2; x < N - 1; x += 2)
+						updatePoint(F + ((size_t) x + (size_t) y * N) * B,
+						            R + ((size_t) x + (size_t) y * N) * B,
+						            B, (size_t) N * B, nact, gamma,
+						            lnorm, track);
+			}
+			t++;
+			if (t < next)
+				continue;
+
+			#pragma omp single
+			{
+				checks++;
+				interval = t - last;
+				last = t;
+				lmax = 0.;
+				for (b = 0; b < nact; b++) {
+					norm[b] = 0.;
+					for (x = 0; x < nthreads; x++)
+						norm[b] = fmax(norm[b], work[x * ld + b]);
+					lmax = fmax(lmax, norm[b]);
+				}
+				if ((NULL != opts->log) &&
+				    ((t / 100 > printed / 100) || (t == tmax))) {
+					opts->log(opts->logdata, t, lmax, prec);
+					printed = t;
+				}
+				/* retire by moving to the last active lane; the
+				 * values follow below, in one pass over the grid */
+				nmove = 0;
+				for (b = 0; b < nact; ) {
+					if (norm[b] > prec) {
+						b++;
+						continue;
+					}
+					if (NULL != stats) {
+						stats[id[b]].sweeps = t;
+						stats[id[b]].checks = checks;
+						stats[id[b]].interval = interval;
+						stats[id[b]].norm = norm[b];
+						stats[id[b]].time = seconds(&t0);
+					}
+					nact--;
+					if (b != nact) {
+						move[2 * nmove] = b;
+						move[2 * nmove + 1] = nact;
+						nmove++;
+					}
+					x = id[b];
+					id[b] = id[nact];
+					id[nact] = x;
+					norm[b] = norm[nact];
+				}
+			}
+			if (nmove > 0) {
+				#pragma omp for
+				for (k = 0; k < n; k++)
+					swapLanes(F + k * B, R + k * B, move, nmove);
+			}
+			every *= opts->check.growth;
+			next = t + ((every > 1) ? (int) every : 1);
+			if (next > tmax)
+				next = tmax;
+		}
+
+		#pragma omp master
+		tdone = t;
+
+		#pragma omp barrier
+		#pragma omp for
+		for (k = 0; k < n; k++)
+			for (b = 0; b < B; b++)
+				f[id[b]][k] = F[k * B + b];
+	}
+
+	/* the ones still active ran out of sweeps */
+	if (NULL != stats)
+		for (b = 0; b < nact; b++) {
+			stats[id[b]].sweeps = tdone;
+			stats[id[b]].checks = checks;
+			stats[id[b]].interval = interval;
+			stats[id[b]].norm = norm[b];
+			stats[id[b]].time = seconds(&t0);
+		}
+
+	free(F);
+	free(work);
+	free(id);
+
+	return 0;
+}
+
+
+/* SOR step of the first nact problems of one point. v is the point, the
+ * neighbors are B and NB values away. The problems are the inner loop, of
+ * unit stride: the neighbors never overlap v[0 .. nact), nact <= B, and
+ * the compiler is told so. */
+static inline void updatePoint(double *v, const double *r, size_t B,
+                               size_t NB, int nact, double gamma,
+                               double *lnorm, int track)
+{
+	double *__restrict__ self = v;
+	const double *__restrict__ west = v - B;
+	const double *__restrict__ east = v + B;
+	const double *__restrict__ south = v - NB;
+	const double *__restrict__ north = v + NB;
+	const double *__restrict__ rhs = r;
+	double val, diff;
+	int b;
+
+	if (!track) {
+		for (b = 0; b < nact; b++)
+			self[b] += gamma * (west[b] + east[b] + south[b] + north[b] -
+			                    4. * self[b] - rhs[b]) / 4.;
+		return;
+	}
+
+	for (b = 0; b < nact; b++) {
+		val = self[b] + gamma * (west[b] + east[b] + south[b] + north[b] -
+		                         4. * self[b] - rhs[b]) / 4.;
+		diff = fabs(val - self[b]);
+		lnorm[b] = (diff > lnorm[b]) ? diff : lnorm[b];
+		self[b] = val;
+	}
+}
+
+
+/* Exchange the lanes of the nmove pairs in move, in order, at the point
+ * of values v and RHS r */
+static inline void swapLanes(double *v, double *r, const int *move,
+                             int nmove)
+{
+	int m, a, b;
+	double tmp;
+
+	for (m = 0; m < nmove; m++) {
+		a = move[2 * m];
+		b = move[2 * m + 1];
+		tmp = v[a];
+		v[a] = v[b];
+		v[b] = tmp;
+		tmp = r[a];
+		r[a] = r[b];
+		r[b] = tmp;
+	}
+}
+
+
+/* Seconds since t0 */
+static double seconds(const struct timespec *t0)
+{
+	struct timespec t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1.E9;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves many Poisson equations in 2D with Dirichlet's condition and
+ * the same grid size together, using SOR.
+ *
+ */
+
+#ifndef POISSONSOR2D_BATCH_H_INCLUDED
+#define POISSONSOR2D_BATCH_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief SOR solver of a batch of Poisson Equations.
+ *
+ * Solves the B problems f[b], rhs[b], each as PoissonSOR2DRHS() would,
+ * in one solve. The problems are copied into one grid with the B values of
+ * each point next to each other, f[b][x + y * N] at (x + y * N) * B + b,
+ * so the update of a point runs over the problems with unit stride and is
+ * vectorized by the compiler. The threads split the rows of the grid, as
+ * in PoissonSOR2DRHS().
+ *
+ * Each problem has its own norm. At each check, the problems whose norm is
+ * below prec are retired: their values are moved to the end of the points,
+ * and the sweeps skip them from then on. The solve ends when all the
+ * problems are retired or after tmax sweeps.
+ *
+ * Only opts->check and opts->log are used, and the norm of the checks is
+ * always SOR_NORM_MAX. The norm of the progress lines is the largest of
+ * the problems still active. stats[b], if stats is not NULL, gets what the solve did
+ * for problem b: the sweeps and seconds until it was retired, the checks,
+ * and its norm at the last check.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonSOR2DBatch(double **f, /**< [in, out] B numerical results */
+                      const double **rhs, /**< [in] B scaled RHS */
+                      int B, /**< [in] number of problems */
+                      double gamma, /**< [in] SOR parameter */
+                      int N, /**< [in] number of grid points in each dimension */
+                      int tmax, /**< [in] maximum number of iterations */
+                      double prec, /**< [in] desired precision */
+                      const SOROptions *opts, /**< [in] options, or NULL */
+                      SORStats *stats /**< [out] B stats, or NULL */);
+
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Updates the solution of a Poisson equation in 2D with Dirichlet's
+ * condition after a change of part of its boundary or RHS, using SOR on the
+ * change only.
+ *
+ */
+
+
+#include "PoissonSOR2D_Incremental.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+static void tileRange(int t, int N, int *lo, int *hi);
+static int seedTile(const double *delta, const double *drhs, int N, int tx,
+                    int ty);
+static double sweepTile(SORSpanKernel span, double *d, const double *drhs,
+                        double gamma, int N, int tx, int ty, int c);
+static void addTile(double *f, const double *d, int N, int tx, int ty);
+
+
+int PoissonSOR2DIncremental(double *f, const double *delta,
+                            const double *drhs, double gamma, int N,
+                            int tmax, double prec, const SOROptions *opts)
+{
+	SOROptions defaults;
+	SORSpanKernel span;
+	struct timespec t0, t1;
+	const int nt = (N > 2) ? (N - 2 + SOR_TILE - 1) / SOR_TILE : 0;
+	const size_t ntiles = (size_t) nt * nt;
+	double *d, *tnorm, norm = 0.;
+	char *seen;
+	int *list;
+	int t = 0, printed = 0, nact, c, i, k, tx, ty;
+
+	if ((NULL == f) || (NULL == delta))
+		return 1;
+
+	if (NULL == opts) {
+		initSOROptions(&defaults);
+		opts = &defaults;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	span = selectSORKernels(opts->kernel)->naturalSpan[(NULL == drhs) ?
+	       SOR_RHS_ZERO : SOR_RHS_ARRAY];
+	/* d is only written where the change gets to: the pages of calloc
+	 * that are never touched cost nothing */
+	d = (double *) calloc((size_t) N * N, sizeof(double));
+	tnorm = (double *) calloc(ntiles + 1, sizeof(double));
+	list = (int *) malloc((ntiles + 1) * sizeof(int));
+	seen = (char *) calloc(ntiles + 1, 1);
+	if ((NULL == d) || (NULL == tnorm) || (NULL == list) || (NULL == seen)) {
+		perror("Incremental arrays allocation error:");
+		free(d);
+		free(tnorm);
+		free(list);
+		free(seen);
+		return -1;
+	}
+
+	for (i = 0; i < N; i++) {
+		d[i] = delta[i];
+		d[i + (size_t) (N - 1) * N] = delta[i + (size_t) (N - 1) * N];
+		d[(size_t) i * N] = delta[(size_t) i * N];
+		d[N - 1 + (size_t) i * N] = delta[N - 1 + (size_t) i * N];
+	}
+
+	nact = 0;
+	for (ty = 0; ty < nt; ty++)
+		for (tx = 0; tx < nt; tx++)
+			if (seedTile(delta, drhs, N, tx, ty))
+				list[nact++] = tx + ty * nt;
+
+	while ((t < tmax) && (nact > 0)) {
+		for (k = 0; k < nact; k++) {
+			tnorm[list[k]] = 0.;
+			seen[list[k]] = 1;
+		}
+
+		/* a point only reads points of the other color, so the tiles
+		 * of one color are independent */
+		for (c = 0; c < 2; c++) {
+			#pragma omp parallel for schedule(dynamic)
+			for (k = 0; k < nact; k++)
+				tnorm[list[k]] = fmax(tnorm[list[k]],
+				                      sweepTile(span, d, drhs, gamma, N,
+				                                list[k] % nt,
+				                                list[k] / nt, c));
+		}
+		t++;
+
+		norm = 0.;
+		for (k = 0; k < nact; k++)
+			norm = fmax(norm, tnorm[list[k]]);
+
+		/* the next active tiles, from the changes of this sweep; the
+		 * tiles not swept changed by 0 */
+		for (k = 0; k < nact; k++)
+			if (tnorm[list[k]] <= prec)
+				tnorm[list[k]] = 0.;
+		nact = 0;
+		for (ty = 0; ty < nt; ty++)
+			for (tx = 0; tx < nt; tx++) {
+				k = tx + ty * nt;
+				if ((tnorm[k] > 0.) ||
+				    ((tx > 0) && (tnorm[k - 1] > 0.)) ||
+				    ((tx < nt - 1) && (tnorm[k + 1] > 0.)) ||
+				    ((ty > 0) && (tnorm[k - nt] > 0.)) ||
+				    ((ty < nt - 1) && (tnorm[k + nt] > 0.)))
+					list[nact++] = k;
+			}
+		/* tnorm of the tiles that stop must read 0 from now on */
+		for (k = 0; k < (int) ntiles; k++)
+			if (tnorm[k] > 0.)
+				tnorm[k] = 0.;
+
+		if ((NULL != opts->log) &&
+		    ((t / 100 > printed / 100) || (0 == nact))) {
+			opts->log(opts->logdata, t, norm, prec);
+			printed = t;
+		}
+	}
+
+	#pragma omp parallel for
+	for (k = 0; k < (int) ntiles; k++)
+		if (seen[k])
+			addTile(f, d, N, k % nt, k / nt);
+	for (i = 0; i < N; i++) {
+		f[i] += d[i];
+		f[i + (size_t) (N - 1) * N] += d[i + (size_t) (N - 1) * N];
+		if ((i > 0) && (i < N - 1)) {
+			f[(size_t) i * N] += d[(size_t) i * N];
+			f[N - 1 + (size_t) i * N] += d[N - 1 + (size_t) i * N];
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (NULL != opts->stats) {
+		opts->stats->sweeps = t;
+		opts->stats->checks = t;
+		opts->stats->interval = (t > 0) ? 1 : 0;
+		opts->stats->norm = norm;
+		opts->stats->time = (t1.tv_sec - t0.tv_sec) +
+		                    (t1.tv_nsec - t0.tv_nsec) / 1.E9;
+	}
+
+	free(d);
+	free(tnorm);
+	free(list);
+	free(seen);
+
+	return 0;
+}
+
+
+/* Interior points [*lo, *hi) of the tile t along x or y */
+static void tileRange(int t, int N, int *lo, int *hi)
+{
+	*lo = 1 + t * SOR_TILE;
+	*hi = (*lo + SOR_TILE < N - 1) ? *lo + SOR_TILE : N - 1;
+}
+
+
+/* Whether the tile (tx, ty) has a change of the RHS, or is next to a
+ * change of the boundary */
+static int seedTile(const double *delta, const double *drhs, int N, int tx,
+                    int ty)
+{
+	int x0, x1, y0, y1, x, y;
+
+	tileRange(tx, N, &x0, &x1);
+	tileRange(ty, N, &y0, &y1);
+
+	for (y = y0; y < y1; y++) {
+		if (((1 == x0) && (0. != delta[(size_t) y * N])) ||
+		    ((N - 1 == x1) && (0. != delta[N - 1 + (size_t) y * N])))
+			return 1;
+		if (NULL != drhs)
+			for (x = x0; x < x1; x++)
+				if (0. != drhs[x + (size_t) y * N])
+					return 1;
+	}
+	for (x = x0; x < x1; x++)
+		if (((1 == y0) && (0. != delta[x])) ||
+		    ((N - 1 == y1) && (0. != delta[x + (size_t) (N - 1) * N])))
+			return 1;
+
+	return 0;
+}
+
+
+/* SOR step of the points of color c, x + y = c (mod 2), of the tile
+ * (tx, ty), one row at a time. Returns the largest change. */
+static double sweepTile(SORSpanKernel span, double *d, const double *drhs,
+                        double gamma, int N, int tx, int ty, int c)
+{
+	int x0, x1, y0, y1, y;
+	size_t off;
+	double lnorm = 0.;
+
+	tileRange(tx, N, &x0, &x1);
+	tileRange(ty, N, &y0, &y1);
+
+	for (y = y0; y < y1; y++) {
+		off = (size_t) y * N;
+		lnorm = fmax(lnorm, span(d + off, d + off, d + off,
+		                         drhs ? drhs + off : NULL, gamma, N,
+		                         (c + y) % 2, x0, x1, SOR_TRACK_MAX));
+	}
+
+	return lnorm;
+}
+
+
+/* f += d on the tile (tx, ty) */
+static void addTile(double *f, const double *d, int N, int tx, int ty)
+{
+	int x0, x1, y0, y1, x, y;
+
+	tileRange(tx, N, &x0, &x1);
+	tileRange(ty, N, &y0, &y1);
+
+	for (y = y0; y < y1; y++)
+		for (x = x0; x < x1; x++)
+			f[x + (size_t) y * N] += d[x + (size_t) y * N];
+}
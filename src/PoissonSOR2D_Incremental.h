@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Updates the solution of a Poisson equation in 2D with Dirichlet's
+ * condition after a change of part of its boundary or RHS, using SOR on the
+ * change only.
+ *
+ */
+
+#ifndef POISSONSOR2D_INCREMENTAL_H_INCLUDED
+#define POISSONSOR2D_INCREMENTAL_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief Points on a side of the tiles of PoissonSOR2DIncremental(). */
+#define SOR_TILE 64
+
+
+/** @brief Incremental SOR solver of Poisson Equation.
+ *
+ * f is the solution of a problem, and the new problem differs from it by
+ * delta on the boundary and by drhs in the scaled RHS. The equation is
+ * linear, so the new solution is f plus the solution d of the equation
+ * with the boundary of delta and the RHS drhs. d is solved from 0 with
+ * red-black SOR, and added to f, boundary included, at the end. f is not
+ * read by the sweeps.
+ *
+ * The interior is cut into tiles of SOR_TILE x SOR_TILE points, and the
+ * sweeps only update the active ones. At the start these are the tiles
+ * that touch a point where delta or drhs is not 0. After each sweep, a
+ * tile stays or becomes active if it or one of its four neighbors changed
+ * by more than prec at some point; the others stop. The work then follows
+ * the change as it spreads and fades, and for a change of a small part of
+ * the boundary it is much less than N^2 per sweep. The active tiles of one
+ * color are swept in parallel.
+ *
+ * The solve ends when no tile is active, which is the max norm of the
+ * changes at or below prec, or after tmax sweeps. Only opts->stats and
+ * opts->log are used; the stats count a check at each sweep.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or delta not allocated
+ */
+int PoissonSOR2DIncremental(double *f, /**< [in, out] solution to update */
+                            const double *delta, /**< [in] change of the
+                                                      boundary values, the
+                                                      interior is not read */
+                            const double *drhs, /**< [in] change of the
+                                                     scaled RHS, or NULL
+                                                     for none */
+                            double gamma, /**< [in] SOR parameter */
+                            int N, /**< [in] number of grid points in each dimension */
+                            int tmax, /**< [in] maximum number of iterations */
+                            double prec, /**< [in] desired precision */
+                            const SOROptions *opts /**< [in] options, or NULL */);
+
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * SOR on a grid split among MPI ranks.
+ *
+ */
+
+
+#include "PoissonSOR2D_MPI.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Block of the interior points owned by one rank. The points x0 .. x0 +
+ * nx - 1 and y0 .. y0 + ny - 1 of the global grid are stored at 1 .. nx
+ * and 1 .. ny of f, which is ld = nx + 2 wide and has a ghost layer of one
+ * point on each side. */
+typedef struct {
+	double *f;
+	double *rhs;
+	int x0, y0, nx, ny, ld;
+	int west, east, south, north; /* neighbor ranks, or MPI_PROC_NULL */
+} SORBlock;
+
+
+/* message tags, by the side of the sender the data comes from */
+enum { TAG_SOUTH, TAG_NORTH, TAG_WEST, TAG_EAST };
+
+
+static void splitRange(int n, int parts, int k, int *lo, int *len);
+static double sweepRows(const SORBlock *blk, SORRowKernel row, int c,
+                        double gamma, int y0, int y1, int track);
+static double sweepColorMPI(const SORBlock *blk, SORRowKernel row, int c,
+                            double gamma, int track, double *cols,
+                            MPI_Comm comm);
+static int gatherBlocks(double *f, const SORBlock *blk, int N, MPI_Comm comm);
+
+
+int PoissonSOR2DMPIRHS(double *f, const double *rhs, double gamma,
+                       int N, int tmax, double prec, MPI_Comm comm,
+                       const SOROptions *opts)
+{
+	SOROptions defaults;
+	SORRowKernel row;
+	SORBlock blk;
+	MPI_Comm cart;
+	int dims[2] = {0, 0}, sizes[2], periods[2] = {0, 0}, coords[2];
+	int nranks, rank, i, j, t = 0, next, track, ret = 0;
+	int printed = 0, checks = 0, last = 0;
+	double *buf, *cols, every, lnorm, norm = prec + 42., time;
+	size_t size;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+
+	if (NULL == opts) {
+		initSOROptions(&defaults);
+		opts = &defaults;
+	}
+	time = MPI_Wtime();
+
+	MPI_Comm_size(comm, &nranks);
+	MPI_Dims_create(nranks, 2, dims);
+	/* dims[0] >= dims[1]: more blocks along y, so the rows stay long */
+	sizes[0] = dims[1];
+	sizes[1] = dims[0];
+	if ((sizes[0] > N - 2) || (sizes[1] > N - 2))
+		return 2;
+
+	/* rank 0 of cart is rank 0 of comm, it gathers the solution */
+	MPI_Cart_create(comm, 2, sizes, periods, 0, &cart);
+	MPI_Comm_rank(cart, &rank);
+	MPI_Cart_coords(cart, rank, 2, coords);
+	MPI_Cart_shift(cart, 0, 1, &blk.west, &blk.east);
+	MPI_Cart_shift(cart, 1, 1, &blk.south, &blk.north);
+
+	splitRange(N - 2, sizes[0], coords[0], &blk.x0, &blk.nx);
+	splitRange(N - 2, sizes[1], coords[1], &blk.y0, &blk.ny);
+	blk.ld = blk.nx + 2;
+
+	/* the block with its ghost layer, its RHS and two edge columns */
+	size = (size_t) blk.ld * (blk.ny + 2);
+	if (!(buf = (double *) malloc((2 * size + 4 * blk.ny) *
+	                              sizeof(double)))) {
+		perror("Block arrays allocation error:");
+		ret = -1;
+	}
+	/* all the ranks give up together, none is left waiting */
+	MPI_Allreduce(MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MIN, cart);
+	if (ret) {
+		free(buf);
+		MPI_Comm_free(&cart);
+		return ret;
+	}
+	blk.f = buf;
+	blk.rhs = buf + size;
+	cols = buf + 2 * size;
+
+	/* the ghost layer starts with the boundary or the initial guess of
+	 * the neighbors, like the rest of the block */
+	for (j = 0; j < blk.ny + 2; j++)
+		for (i = 0; i < blk.ld; i++) {
+			blk.f[i + j * blk.ld] = f[(blk.x0 - 1 + i) +
+			                          (size_t) (blk.y0 - 1 + j) * N];
+			blk.rhs[i + j * blk.ld] = rhs[(blk.x0 - 1 + i) +
+			                              (size_t) (blk.y0 - 1 + j) * N];
+		}
+
+	row = selectSORKernels(opts->kernel)->natural;
+	track = SOR_TRACK_MAX;
+	every = (opts->check.every > 1) ? opts->check.every : 1;
+	next = (every < tmax) ? (int) every : tmax;
+
+	/* All the ranks take the same decisions: the norm of the checks is
+	 * the same everywhere after the reduction. */
+	while ((t < tmax) && (norm > prec)) {
+		i = (t + 1 == next) ? track : 0;
+		lnorm = sweepColorMPI(&blk, row, 0, gamma, i, cols, cart);
+		lnorm = fmax(lnorm, sweepColorMPI(&blk, row, 1, gamma, i, cols,
+		                                  cart));
+		t++;
+		if (t < next)
+			continue;
+
+		MPI_Allreduce(&lnorm, &norm, 1, MPI_DOUBLE, MPI_MAX, cart);
+		checks++;
+		if (NULL != opts->stats)
+			opts->stats->interval = t - last;
+		last = t;
+		if ((0 == rank) && (NULL != opts->log) &&
+		    ((t / 100 > printed / 100) || norm < prec)) {
+			opts->log(opts->logdata, t, norm, prec);
+			printed = t;
+		}
+		every *= opts->check.growth;
+		next = t + ((every > 1) ? (int) every : 1);
+		if (next > tmax)
+			next = tmax;
+	}
+
+	if (NULL != opts->stats) {
+		opts->stats->sweeps = t;
+		opts->stats->checks = checks;
+		if (0 == checks)
+			opts->stats->interval = 0;
+		opts->stats->norm = norm;
+		opts->stats->time = MPI_Wtime() - time;
+	}
+
+	/* the own block back to f, then all of them to rank 0 */
+	for (j = 1; j <= blk.ny; j++)
+		memcpy(f + blk.x0 + (size_t) (blk.y0 - 1 + j) * N,
+		       blk.f + 1 + j * blk.ld, blk.nx * sizeof(double));
+	ret = gatherBlocks(f, &blk, N, cart);
+
+	free(buf);
+	MPI_Comm_free(&cart);
+
+	return ret;
+}
+
+
+/* Part k of parts of the interior points 1 .. n, of sizes that differ by
+ * at most one point */
+static void splitRange(int n, int parts, int k, int *lo, int *len)
+{
+	const int a = (int) ((long) n * k / parts);
+	const int b = (int) ((long) n * (k + 1) / parts);
+
+	*lo = 1 + a;
+	*len = b - a;
+}
+
+
+/* Rows y0 .. y1 - 1 of color c of the block. The parity of the rows is the
+ * one of the global grid, so the colors match the ones of update(). */
+static double sweepRows(const SORBlock *blk, SORRowKernel row, int c,
+                        double gamma, int y0, int y1, int track)
+{
+	double norm = 0., r;
+	size_t off;
+	int y;
+
+	for (y = y0; y < y1; y++) {
+		off = (size_t) y * blk->ld;
+		r = row(blk->f + off, blk->f + off, blk->f + off,
+		        blk->rhs + off, gamma, blk->ld,
+		        (c + blk->y0 + y + blk->x0) % 2, track);
+		norm = fmax(norm, r);
+	}
+
+	return norm;
+}
+
+
+/* One color of the block followed by the exchange of the ghost layer. The
+ * first and last rows go first, so they travel while the inner rows are
+ * updated. The kernels always update whole rows, so the edge columns are
+ * only ready at the end and are exchanged after the inner rows. The whole
+ * edges are sent, not only the points of color c. */
+static double sweepColorMPI(const SORBlock *blk, SORRowKernel row, int c,
+                            double gamma, int track, double *cols,
+                            MPI_Comm comm)
+{
+	MPI_Request req[8];
+	const int ld = blk->ld, nx = blk->nx, ny = blk->ny;
+	double *f = blk->f, norm;
+	int j;
+
+	norm = sweepRows(blk, row, c, gamma, 1, 2, track);
+	if (ny > 1)
+		norm = fmax(norm, sweepRows(blk, row, c, gamma, ny, ny + 1,
+		                            track));
+
+	/* the ghost rows are only read by the edge rows, which are done */
+	MPI_Irecv(f + 1, nx, MPI_DOUBLE, blk->south, TAG_NORTH, comm, req);
+	MPI_Irecv(f + 1 + (ny + 1) * ld, nx, MPI_DOUBLE, blk->north,
+	          TAG_SOUTH, comm, req + 1);
+	MPI_Isend(f + 1 + ld, nx, MPI_DOUBLE, blk->south, TAG_SOUTH, comm,
+	          req + 2);
+	MPI_Isend(f + 1 + ny * ld, nx, MPI_DOUBLE, blk->north, TAG_NORTH, comm,
+	          req + 3);
+
+	norm = fmax(norm, sweepRows(blk, row, c, gamma, 2, ny, track));
+
+	/* cols: the west and east edges, then the west and east ghosts */
+	for (j = 0; j < ny; j++) {
+		cols[j] = f[1 + (j + 1) * ld];
+		cols[ny + j] = f[nx + (j + 1) * ld];
+	}
+	MPI_Irecv(cols + 2 * ny, ny, MPI_DOUBLE, blk->west, TAG_EAST, comm,
+	          req + 4);
+	MPI_Irecv(cols + 3 * ny, ny, MPI_DOUBLE, blk->east, TAG_WEST, comm,
+	          req + 5);
+	MPI_Isend(cols, ny, MPI_DOUBLE, blk->west, TAG_WEST, comm, req + 6);
+	MPI_Isend(cols + ny, ny, MPI_DOUBLE, blk->east, TAG_EAST, comm,
+	          req + 7);
+	MPI_Waitall(8, req, MPI_STATUSES_IGNORE);
+
+	/* no neighbor: the ghost is the boundary, which is never written */
+	for (j = 0; j < ny; j++) {
+		if (MPI_PROC_NULL != blk->west)
+			f[(j + 1) * ld] = cols[2 * ny + j];
+		if (MPI_PROC_NULL != blk->east)
+			f[nx + 1 + (j + 1) * ld] = cols[3 * ny + j];
+	}
+
+	return norm;
+}
+
+
+/* Interior points of all the blocks into f on rank 0 */
+static int gatherBlocks(double *f, const SORBlock *blk, int N, MPI_Comm comm)
+{
+	int desc[4] = {blk->x0, blk->y0, blk->nx, blk->ny};
+	int *all = NULL, *counts = NULL, *displs = NULL;
+	int nranks, rank, k, j, total = 0, err = 0;
+	double *send, *recv = NULL;
+
+	MPI_Comm_size(comm, &nranks);
+	MPI_Comm_rank(comm, &rank);
+
+	if (!(send = (double *) malloc((size_t) blk->nx * blk->ny *
+	                               sizeof(double)))) {
+		perror("Gather arrays allocation error:");
+		err = 1;
+	}
+	if (0 == rank) {
+		all = (int *) malloc(6 * nranks * sizeof(int));
+		if (NULL == all) {
+			perror("Gather arrays allocation error:");
+			err = 1;
+		}
+	}
+	/* every rank must take part in the collectives below, or none */
+	MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MAX, comm);
+	if (err) {
+		free(send);
+		free(all);
+		return -1;
+	}
+
+	for (j = 0; j < blk->ny; j++)
+		memcpy(send + (size_t) j * blk->nx, blk->f + 1 + (j + 1) * blk->ld,
+		       blk->nx * sizeof(double));
+
+	MPI_Gather(desc, 4, MPI_INT, all, 4, MPI_INT, 0, comm);
+	if (0 == rank) {
+		counts = all + 4 * nranks;
+		displs = counts + nranks;
+		for (k = 0; k < nranks; k++) {
+			counts[k] = all[4 * k + 2] * all[4 * k + 3];
+			displs[k] = total;
+			total += counts[k];
+		}
+		if (!(recv = (double *) malloc(total * sizeof(double)))) {
+			perror("Gather arrays allocation error:");
+			err = 1;
+		}
+	}
+	MPI_Bcast(&err, 1, MPI_INT, 0, comm);
+	if (err) {
+		free(send);
+		free(all);
+		return -1;
+	}
+
+	MPI_Gatherv(send, blk->nx * blk->ny, MPI_DOUBLE, recv, counts, displs,
+	            MPI_DOUBLE, 0, comm);
+
+	if (0 == rank)
+		for (k = 0; k < nranks; k++)
+			for (j = 0; j < all[4 * k + 3]; j++)
+				memcpy(f + all[4 * k] +
+				       (size_t) (all[4 * k + 1] + j) * N,
+				       recv + displs[k] + (size_t) j * all[4 * k + 2],
+				       all[4 * k + 2] * sizeof(double));
+
+	free(send);
+	free(all);
+	free(recv);
+
+	return 0;
+}
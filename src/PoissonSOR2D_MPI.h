@@ -0,0 +1,56 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * SOR on a grid split among MPI ranks.
+ *
+ */
+
+#ifndef POISSONSOR2D_MPI_H_INCLUDED
+#define POISSONSOR2D_MPI_H_INCLUDED
+
+#include <mpi.h>
+#include "PoissonSOR2D.h"
+
+
+/** @brief Solver of Poisson Equation on MPI ranks.
+ *
+ * Same as PoissonSOR2DRHS(), with the sweeps split among the ranks of comm.
+ * The ranks are arranged in a 2D grid (MPI_Dims_create()) and each rank
+ * sweeps one block of the interior points, stored with a ghost layer of
+ * one point around it. The rows of a block are updated by the same kernels
+ * as update(), with the block width as row length.
+ *
+ * After each color the ghost layers are refreshed from the neighbor
+ * blocks. The edge rows of the block are updated first and sent while the
+ * inner rows are updated; the edge columns are exchanged after that. The
+ * norm of the checks is combined over the ranks with a max reduction, so
+ * all the ranks stop at the same sweep. The result is the same as the one
+ * of PoissonSOR2DRHS() with the natural layout.
+ *
+ * f and rhs are the whole grids on every rank, as for PoissonSOR2DRHS().
+ * On return, f holds the solution on rank 0 of comm, and on the other
+ * ranks only their own block is updated.
+ *
+ * Only opts->kernel and opts->check are used, and the norm of the checks
+ * is always SOR_NORM_MAX. opts->stats is filled on every rank.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ * * 2 on blocks without an interior point: more ranks along a side than
+ *   the N - 2 interior points of that side
+ */
+int PoissonSOR2DMPIRHS(double *f, /**< [in, out] numerical result */
+                       const double *rhs, /**< [in] scaled RHS */
+                       double gamma, /**< [in] SOR parameter */
+                       int N, /**< [in] number of grid points in each dimension */
+                       int tmax, /**< [in] maximum number of iterations */
+                       double prec, /**< [in] desired precision */
+                       MPI_Comm comm, /**< [in] ranks to solve on */
+                       const SOROptions *opts /**< [in] options, or NULL */);
+
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * SOR in single precision, alone or inside a double precision refinement.
+ *
+ */
+
+
+#include "PoissonSOR2D_Mixed.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* Split float grid as seen by the sweeps, as SORGrid in PoissonSOR2D.c:
+ * color[0] and rhs[0] are the black points, rows W values apart. */
+typedef struct {
+	float *color[2];
+	float *rhs[2];
+	int W;
+	SORRowKernelF row;
+} SORGridF;
+
+
+static int initGridF(SORGridF *grid, int N, const SOROptions *opts);
+static float sweepF(const SORGridF *grid, float gamma, int N, int track);
+static void solveF(const SORGridF *grid, float gamma, int N, int tmax,
+                   float prec, const SOROptions *opts, SORStats *stats,
+                   int verbose);
+static double seconds(const struct timespec *t0);
+
+
+int PoissonSOR2DRHSf(float *f, const float *rhs, float gamma,
+                     int N, int tmax, float prec, const SOROptions *opts)
+{
+	SOROptions defaults;
+	SORGridF grid;
+	SORStats stats = {0, 0, 0, 0., 0.};
+	struct timespec t0;
+	int i, j;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+
+	if (NULL == opts) {
+		initSOROptions(&defaults);
+		opts = &defaults;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (initGridF(&grid, N, opts))
+		return -1;
+
+	#pragma omp parallel for private(i)
+	for (j = 0; j < N; j++)
+		for (i = 0; i < N; i++) {
+			grid.color[(i + j) % 2][i / 2 + j * grid.W] = f[i + j * N];
+			grid.rhs[(i + j) % 2][i / 2 + j * grid.W] = rhs[i + j * N];
+		}
+
+	solveF(&grid, gamma, N, tmax, prec, opts, &stats, 1);
+
+	#pragma omp parallel for private(i)
+	for (j = 0; j < N; j++)
+		for (i = 0; i < N; i++)
+			f[i + j * N] = grid.color[(i + j) % 2][i / 2 + j * grid.W];
+
+	if (NULL != opts->stats) {
+		stats.time = seconds(&t0);
+		*opts->stats = stats;
+	}
+
+	free(grid.color[1]);
+	return 0;
+}
+
+
+/* Iterative refinement: with r = rhs - L f the residual of f, the
+ * correction e solves L e = r with e = 0 on the boundary, and f + e solves
+ * the problem. e only needs a few digits, which the floats have. */
+int PoissonSOR2DMixed(double *f, const double *rhs, double gamma,
+                      int N, int tmax, double prec, const SOROptions *opts)
+{
+	SOROptions defaults;
+	SORGridF grid;
+	SORStats stats = {0, 0, 0, 0., 0.};
+	struct timespec t0;
+	double *res, norm, last = 0.;
+	int i, j, round = 0;
+
+	if ((NULL == f) || (NULL == rhs))
+		return 1;
+
+	if (NULL == opts) {
+		initSOROptions(&defaults);
+		opts = &defaults;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (!(res = allocGrid(N, opts->alloc))) {
+		perror("Residual array allocation error:");
+		return -1;
+	}
+	if (initGridF(&grid, N, opts)) {
+		free(res);
+		return -1;
+	}
+
+	for (;;) {
+		norm = residual(res, f, rhs, N) / 4.;
+		if (NULL != opts->log)
+			opts->log(opts->logdata, stats.sweeps, norm, prec);
+		/* stop when done, out of sweeps, or when the floats cannot
+		 * improve the correction any more */
+		if ((norm < prec) || (stats.sweeps >= tmax) ||
+		    ((round > 0) && (norm > 0.5 * last)))
+			break;
+		last = norm;
+		round++;
+
+		#pragma omp parallel for private(i)
+		for (j = 0; j < N; j++)
+			for (i = 0; i < N; i++) {
+				grid.color[(i + j) % 2][i / 2 + j * grid.W] = 0.f;
+				grid.rhs[(i + j) % 2][i / 2 + j * grid.W] =
+					(float) res[i + j * N];
+			}
+
+		solveF(&grid, gamma, N, tmax - stats.sweeps,
+		       fmax(norm * SOR_MIXED_REDUCE, prec / 2.), opts, &stats,
+		       0);
+
+		#pragma omp parallel for private(i)
+		for (j = 1; j < N - 1; j++)
+			for (i = 1; i < N - 1; i++)
+				f[i + j * N] +=
+					grid.color[(i + j) % 2][i / 2 + j * grid.W];
+	}
+
+	if (NULL != opts->stats) {
+		stats.norm = norm;
+		stats.time = seconds(&t0);
+		*opts->stats = stats;
+	}
+
+	free(grid.color[1]);
+	free(res);
+	return 0;
+}
+
+
+/* Allocates the two colors and their RHS in one block at color[1], placed
+ * by the threads that sweep them */
+static int initGridF(SORGridF *grid, int N, const SOROptions *opts)
+{
+	const size_t W = (N + 1) / 2;
+	const size_t half = N * W;
+	float *buf;
+
+	if (!(buf = (float *) allocRows(W * sizeof(float), N, 4,
+	                                opts->alloc))) {
+		perror("Single precision arrays allocation error:");
+		return -1;
+	}
+
+	grid->color[1] = buf;
+	grid->color[0] = buf + half;
+	grid->rhs[1] = buf + 2 * half;
+	grid->rhs[0] = buf + 3 * half;
+	grid->W = W;
+	grid->row = selectSORKernels(opts->kernel)->redblack32;
+
+	return 0;
+}
+
+
+/* One sweep, both colors */
+static float sweepF(const SORGridF *grid, float gamma, int N, int track)
+{
+	float lnorm = 0.f, r;
+	size_t off;
+	int c, j;
+
+	for (c = 0; c < 2; c++) {
+		#pragma omp parallel for private(off, r) reduction(max:lnorm)
+		for (j = 1; j < N - 1; j++) {
+			off = (size_t) j * grid->W;
+			r = grid->row(grid->color[c] + off, grid->color[c] + off,
+			              grid->color[1 - c] + off, grid->rhs[c] + off,
+			              gamma, N, (c + j) % 2, track);
+			lnorm = fmaxf(lnorm, r);
+		}
+	}
+
+	return lnorm;
+}
+
+
+/* Sweeps until the largest change is below prec or tmax sweeps, with the
+ * checks of opts->check. Adds the sweeps and checks to stats. */
+static void solveF(const SORGridF *grid, float gamma, int N, int tmax,
+                   float prec, const SOROptions *opts, SORStats *stats,
+                   int verbose)
+{
+	int t = 0, next, last = 0, printed = 0;
+	double every;
+	float lnorm, norm = prec + 42.f;
+
+	every = (opts->check.every > 1) ? opts->check.every : 1;
+	next = (every < tmax) ? (int) every : tmax;
+
+	while ((t < tmax) && (norm > prec)) {
+		lnorm = sweepF(grid, gamma, N,
+		               (t + 1 == next) ? SOR_TRACK_MAX : SOR_TRACK_NONE);
+		t++;
+		if (t < next)
+			continue;
+
+		norm = lnorm;
+		stats->checks++;
+		stats->interval = t - last;
+		last = t;
+		if (verbose && (NULL != opts->log) &&
+		    ((t / 100 > printed / 100) || norm < prec)) {
+			opts->log(opts->logdata, t, norm, prec);
+			printed = t;
+		}
+		every *= opts->check.growth;
+		next = t + ((every > 1) ? (int) every : 1);
+		if (next > tmax)
+			next = tmax;
+	}
+
+	stats->sweeps += t;
+	stats->norm = norm;
+}
+
+
+/* Seconds since t0 */
+static double seconds(const struct timespec *t0)
+{
+	struct timespec t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1.E9;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Solves a Poisson equation in 2D with Dirichlet's condition using
+ * SOR in single precision, alone or inside a double precision refinement.
+ *
+ */
+
+#ifndef POISSONSOR2D_MIXED_H_INCLUDED
+#define POISSONSOR2D_MIXED_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief Single precision solver of Poisson Equation.
+ *
+ * Same as PoissonSOR2DRHS() with float values. The sweeps run on the split
+ * red-black layout, see toRedBlack(), through the single precision kernels
+ * of PoissonSOR2D_SIMD.h, which read half the bytes of the double ones.
+ * float has about 7 significant digits, so prec should not go below about
+ * 1E-7 times the values of f.
+ *
+ * Only opts->kernel, opts->check, opts->stats and opts->log are used, and
+ * the norm of the checks is always the largest change, SOR_NORM_MAX.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonSOR2DRHSf(float *f, /**< [in, out] numerical result */
+                     const float *rhs, /**< [in] scaled RHS of Poisson Eq */
+                     float gamma, /**< [in] SOR parameter */
+                     int N, /**< [in] number of grid points in each dimension */
+                     int tmax, /**< [in] maximum number of iterations */
+                     float prec, /**< [in] desired precision */
+                     const SOROptions *opts /**< [in] options, or NULL */);
+
+
+/** @brief Mixed precision solver of Poisson Equation.
+ *
+ * Same arguments as PoissonSOR2DRHS(), with the sweeps in single
+ * precision. Each round computes the residual of f in double precision,
+ * see residual(), solves for the correction with the single precision SOR
+ * of PoissonSOR2DRHSf() until its changes are SOR_MIXED_REDUCE times the
+ * residual, and adds the correction to f. The solve stops when the
+ * largest residual divided by 4 is below prec, as SOR_NORM_RESIDUAL does,
+ * so the result meets prec in double precision.
+ *
+ * Each round gains about 3 digits, so most of the sweeps run on floats. The
+ * rounds stop improving when N^2 times the float precision gets near 1,
+ * N of several thousands; the solve then stops with the residual it has.
+ *
+ * tmax is the maximum number of single precision sweeps of all the rounds.
+ * opts->stats gets these sweeps and the last residual divided by 4, and
+ * opts->log gets them at the start of each round instead of the progress
+ * of the single precision sweeps.
+ *
+ * @return
+ * * 0 on success
+ * * -1 on memory error
+ * * 1 on f or rhs not allocated
+ */
+int PoissonSOR2DMixed(double *f, /**< [in, out] numerical result */
+                      const double *rhs, /**< [in] scaled RHS of Poisson Eq */
+                      double gamma, /**< [in] SOR parameter */
+                      int N, /**< [in] number of grid points in each dimension */
+                      int tmax, /**< [in] maximum number of sweeps */
+                      double prec, /**< [in] desired precision */
+                      const SOROptions *opts /**< [in] options, or NULL */);
+
+
+/** @brief Reduction of the residual aimed at by each round of
+ * PoissonSOR2DMixed(). */
+#define SOR_MIXED_REDUCE 1E-3
+
+
+#endif
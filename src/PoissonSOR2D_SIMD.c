@@ -0,0 +1,912 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Row kernels of the SOR sweeps, with SIMD versions picked at runtime.
+ *
+ */
+
+
+#include "PoissonSOR2D_SIMD.h"
+#include <math.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+/* Add the change of one point to the norm of a row */
+static inline double addChange(double lnorm, double diff, int track)
+{
+	if (SOR_TRACK_SUM2 == track)
+		return lnorm + diff * diff;
+	diff = fabs(diff);
+	return (diff > lnorm) ? diff : lnorm;
+}
+
+
+/* Value of the RHS at the point i of a row for the kind of RHS, see
+ * SORRhs. The kind is a constant in every caller, so the branch and, for
+ * SOR_RHS_ZERO, the subtraction fold away. */
+static inline double rhsAt(const double *rhs, int i, double r0, int kind)
+{
+	return (SOR_RHS_ARRAY == kind) ? rhs[i] : r0;
+}
+
+
+/* The double kernels are written once for any kind of RHS and norm, in
+ * functions always inlined into the variants below with kind and track as
+ * constants. The natural ones update the points of the row in [x0, x1),
+ * x0 odd, and the whole interior of the row through body##T(). */
+__attribute__((always_inline))
+static inline double naturalScalarSpanT(double *dst, const double *self,
+                                        const double *oth, const double *rhs,
+                                        double gamma, int N, int p, int x0,
+                                        int x1, int track, int kind)
+{
+	double lnorm = 0, val;
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int i;
+
+	for (i = x0 + (x0 + p) % 2; i < x1; i += 2) {
+		val = self[i] +
+		      gamma * (oth[i-1] +
+		               oth[i+1] +
+		               oth[i-N] +
+		               oth[i+N] -
+		               4. * self[i] -
+		               rhsAt(rhs, i, r0, kind)) / 4.;
+		if (track)
+			lnorm = addChange(lnorm, val - self[i], track);
+		dst[i] = val;
+	}
+
+	return lnorm;
+}
+
+
+__attribute__((always_inline))
+static inline double naturalScalarT(double *dst, const double *self,
+                                    const double *oth, const double *rhs,
+                                    double gamma, int N, int p, int track,
+                                    int kind)
+{
+	return naturalScalarSpanT(dst, self, oth, rhs, gamma, N, p, 1, N - 1,
+	                          track, kind);
+}
+
+
+/* In the split layout the point k is x = 2k + p, its left and right
+ * neighbors are oth[k + p - 1] and oth[k + p]. */
+__attribute__((always_inline))
+static inline double redBlackScalarT(double *dst, const double *self,
+                                     const double *oth, const double *rhs,
+                                     double gamma, int N, int p, int track,
+                                     int kind)
+{
+	const int W = (N + 1) / 2;
+	const int kmax = (N - 2 - p) / 2;
+	const double *side = oth + p - 1;
+	double lnorm = 0, val;
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int k;
+
+	for (k = 1 - p; k <= kmax; k++) {
+		val = self[k] +
+		      gamma * (side[k] +
+		               side[k + 1] +
+		               oth[k - W] +
+		               oth[k + W] -
+		               4. * self[k] -
+		               rhsAt(rhs, k, r0, kind)) / 4.;
+		if (track)
+			lnorm = addChange(lnorm, val - self[k], track);
+		dst[k] = val;
+	}
+
+	return lnorm;
+}
+
+
+/* New value of the point i of a row with the compact 9-point stencil, see
+ * SOR_STENCIL_9: the four sides weigh 4 and the corners 1, over 20. g20 is
+ * gamma / 20. */
+static inline double compactAt(const double *self, const double *oth,
+                               const double *rhs, int i, int N, double g20,
+                               double r0, int kind)
+{
+	return self[i] +
+	       g20 * (4. * (oth[i-1] +
+	                    oth[i+1] +
+	                    oth[i-N] +
+	                    oth[i+N]) +
+	              oth[i-N-1] +
+	              oth[i-N+1] +
+	              oth[i+N-1] +
+	              oth[i+N+1] -
+	              20. * self[i] -
+	              rhsAt(rhs, i, r0, kind));
+}
+
+
+/* The compact kernels run on the natural layout, on the points of parity
+ * p of the row, as the natural ones. */
+__attribute__((always_inline))
+static inline double compactScalarT(double *dst, const double *self,
+                                    const double *oth, const double *rhs,
+                                    double gamma, int N, int p, int track,
+                                    int kind)
+{
+	const double g20 = gamma / 20.;
+	double lnorm = 0, val;
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int i;
+
+	for (i = 2 - p; i < N - 1; i += 2) {
+		val = compactAt(self, oth, rhs, i, N, g20, r0, kind);
+		if (track)
+			lnorm = addChange(lnorm, val - self[i], track);
+		dst[i] = val;
+	}
+
+	return lnorm;
+}
+
+
+/* Add the change of one point to the norm of a row, single precision */
+static inline float addChangeF(float lnorm, float diff, int track)
+{
+	if (SOR_TRACK_SUM2 == track)
+		return lnorm + diff * diff;
+	diff = fabsf(diff);
+	return (diff > lnorm) ? diff : lnorm;
+}
+
+
+static float redBlackScalarF(float *dst, const float *self,
+                             const float *oth, const float *rhs,
+                             float gamma, int N, int p, int track)
+{
+	const int W = (N + 1) / 2;
+	const int kmax = (N - 2 - p) / 2;
+	const float *side = oth + p - 1;
+	float lnorm = 0, val;
+	int k;
+
+	for (k = 1 - p; k <= kmax; k++) {
+		val = self[k] +
+		      gamma * (side[k] +
+		               side[k + 1] +
+		               oth[k - W] +
+		               oth[k + W] -
+		               4.f * self[k] -
+		               rhs[k]) / 4.f;
+		if (track)
+			lnorm = addChangeF(lnorm, val - self[k], track);
+		dst[k] = val;
+	}
+
+	return lnorm;
+}
+
+
+#ifdef HAVE_X86_SIMD
+
+/* Add the changes of 4 points to the per-lane norms */
+__attribute__((target("avx2")))
+static inline __m256d addChange256(__m256d vnorm, __m256d vdiff, int track)
+{
+	if (SOR_TRACK_SUM2 == track)
+		return _mm256_add_pd(vnorm, _mm256_mul_pd(vdiff, vdiff));
+	return _mm256_max_pd(vnorm,
+	                     _mm256_andnot_pd(_mm256_set1_pd(-0.), vdiff));
+}
+
+
+/* Add the changes of the points in mask to the per-lane norms */
+__attribute__((target("avx512f")))
+static inline __m512d addChange512(__m512d vnorm, __mmask8 mask,
+                                   __m512d vdiff, int track)
+{
+	if (SOR_TRACK_SUM2 == track)
+		return _mm512_mask_add_pd(vnorm, mask, vnorm,
+		                          _mm512_mul_pd(vdiff, vdiff));
+	return _mm512_mask_max_pd(vnorm, mask, vnorm, _mm512_abs_pd(vdiff));
+}
+
+
+/* The natural layout is updated 4 consecutive points at a time, starting
+ * at x = x0. All of them are computed, but only the ones of the right color
+ * are stored into dst, with a masked store, so the points of the other
+ * color are not written at all. The left and right neighbors are shuffled
+ * from the previous, current and next blocks of the row: unaligned loads
+ * would overlap the block just stored when dst and oth are the same array,
+ * and stall on store forwarding. Of the block before x0 only its last
+ * value, oth[x0 - 1], is used and loaded, so a span reads oth in
+ * [x0 - 1, x1] only. */
+__attribute__((target("avx2"), always_inline))
+static inline double naturalAVX2SpanT(double *dst, const double *self,
+                                      const double *oth, const double *rhs,
+                                      double gamma, int N, int p, int x0,
+                                      int x1, int track, int kind)
+{
+	const __m256d vgamma = _mm256_set1_pd(gamma);
+	const __m256d vfour = _mm256_set1_pd(4.);
+	const __m256d vquarter = _mm256_set1_pd(0.25);
+	const __m256i imask = p ? _mm256_set_epi64x(0, -1, 0, -1) :
+	                          _mm256_set_epi64x(-1, 0, -1, 0);
+	const __m256d mask = _mm256_castsi256_pd(imask);
+	__m256d prev, cur, next, vs, vnew, vnorm = _mm256_setzero_pd();
+	double lnorm = 0, val, lanes[4];
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int i;
+
+	/* the first blocks are only loaded when the loop runs: on a short
+	 * row they would reach outside the grid */
+	if (x1 + 1 - x0 >= 8) {
+		prev = _mm256_broadcast_sd(oth + x0 - 1);
+		cur = _mm256_loadu_pd(oth + x0);
+	} else {
+		prev = cur = _mm256_setzero_pd();
+	}
+	for (i = x0; i + 8 <= x1 + 1; i += 4) {
+		next = _mm256_loadu_pd(oth + i + 4);
+		vs = _mm256_loadu_pd(self + i);
+		/* [prev3 cur0 cur1 cur2] + [cur1 cur2 cur3 next0] */
+		vnew = _mm256_add_pd(
+		       _mm256_shuffle_pd(_mm256_permute2f128_pd(prev, cur, 0x21),
+		                         cur, 0x5),
+		       _mm256_shuffle_pd(cur,
+		                         _mm256_permute2f128_pd(cur, next, 0x21),
+		                         0x5));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i - N));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i + N));
+		vnew = _mm256_sub_pd(vnew, _mm256_mul_pd(vfour, vs));
+		if (SOR_RHS_ARRAY == kind)
+			vnew = _mm256_sub_pd(vnew, _mm256_loadu_pd(rhs + i));
+		else if (SOR_RHS_CONST == kind)
+			vnew = _mm256_sub_pd(vnew, _mm256_set1_pd(r0));
+		vnew = _mm256_mul_pd(_mm256_mul_pd(vgamma, vnew), vquarter);
+		vnew = _mm256_add_pd(vs, vnew);
+		_mm256_maskstore_pd(dst + i, imask, vnew);
+		if (track)
+			vnorm = addChange256(vnorm, _mm256_and_pd(mask,
+			        _mm256_sub_pd(vs, vnew)), track);
+		prev = cur;
+		cur = next;
+	}
+
+	/* remainder of the row */
+	if (i % 2 != p)
+		i++;
+	for (; i < x1; i += 2) {
+		val = self[i] +
+		      gamma * (oth[i-1] +
+		               oth[i+1] +
+		               oth[i-N] +
+		               oth[i+N] -
+		               4. * self[i] -
+		               rhsAt(rhs, i, r0, kind)) / 4.;
+		if (track)
+			lnorm = addChange(lnorm, val - self[i], track);
+		dst[i] = val;
+	}
+
+	if (track) {
+		_mm256_storeu_pd(lanes, vnorm);
+		for (i = 0; i < 4; i++)
+			lnorm = (SOR_TRACK_SUM2 == track) ? lnorm + lanes[i]
+			        : ((lanes[i] > lnorm) ? lanes[i] : lnorm);
+	}
+
+	return lnorm;
+}
+
+
+__attribute__((target("avx2"), always_inline))
+static inline double naturalAVX2T(double *dst, const double *self,
+                                  const double *oth, const double *rhs,
+                                  double gamma, int N, int p, int track,
+                                  int kind)
+{
+	return naturalAVX2SpanT(dst, self, oth, rhs, gamma, N, p, 1, N - 1,
+	                        track, kind);
+}
+
+
+__attribute__((target("avx2"), always_inline))
+static inline double redBlackAVX2T(double *dst, const double *self,
+                                   const double *oth, const double *rhs,
+                                   double gamma, int N, int p, int track,
+                                   int kind)
+{
+	const int W = (N + 1) / 2;
+	const int kmax = (N - 2 - p) / 2;
+	const double *side = oth + p - 1;
+	const __m256d vgamma = _mm256_set1_pd(gamma);
+	const __m256d vfour = _mm256_set1_pd(4.);
+	const __m256d vquarter = _mm256_set1_pd(0.25);
+	__m256d vs, vnew, vnorm = _mm256_setzero_pd();
+	double lnorm = 0, val, lanes[4];
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int k;
+
+	for (k = 1 - p; k + 4 <= kmax + 1; k += 4) {
+		vs = _mm256_loadu_pd(self + k);
+		vnew = _mm256_add_pd(_mm256_loadu_pd(side + k),
+		                     _mm256_loadu_pd(side + k + 1));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + k - W));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + k + W));
+		vnew = _mm256_sub_pd(vnew, _mm256_mul_pd(vfour, vs));
+		if (SOR_RHS_ARRAY == kind)
+			vnew = _mm256_sub_pd(vnew, _mm256_loadu_pd(rhs + k));
+		else if (SOR_RHS_CONST == kind)
+			vnew = _mm256_sub_pd(vnew, _mm256_set1_pd(r0));
+		vnew = _mm256_mul_pd(_mm256_mul_pd(vgamma, vnew), vquarter);
+		vnew = _mm256_add_pd(vs, vnew);
+		_mm256_storeu_pd(dst + k, vnew);
+		if (track)
+			vnorm = addChange256(vnorm, _mm256_sub_pd(vs, vnew),
+			                     track);
+	}
+
+	for (; k <= kmax; k++) {
+		val = self[k] +
+		      gamma * (side[k] +
+		               side[k + 1] +
+		               oth[k - W] +
+		               oth[k + W] -
+		               4. * self[k] -
+		               rhsAt(rhs, k, r0, kind)) / 4.;
+		if (track)
+			lnorm = addChange(lnorm, val - self[k], track);
+		dst[k] = val;
+	}
+
+	if (track) {
+		_mm256_storeu_pd(lanes, vnorm);
+		for (k = 0; k < 4; k++)
+			lnorm = (SOR_TRACK_SUM2 == track) ? lnorm + lanes[k]
+			        : ((lanes[k] > lnorm) ? lanes[k] : lnorm);
+	}
+
+	return lnorm;
+}
+
+
+/* Same as naturalAVX2SpanT() on the whole row for the compact stencil, with
+ * the same guard of the first loads. The corners are on the rows above and
+ * below, which are of other colors and not written during the sweep, so
+ * they are loaded unaligned. */
+__attribute__((target("avx2"), always_inline))
+static inline double compactAVX2T(double *dst, const double *self,
+                                  const double *oth, const double *rhs,
+                                  double gamma, int N, int p, int track,
+                                  int kind)
+{
+	const double g20 = gamma / 20.;
+	const __m256d vg20 = _mm256_set1_pd(g20);
+	const __m256d vfour = _mm256_set1_pd(4.);
+	const __m256d vtwenty = _mm256_set1_pd(20.);
+	const __m256d mask = _mm256_castsi256_pd(p ?
+	                     _mm256_set_epi64x(0, -1, 0, -1) :
+	                     _mm256_set_epi64x(-1, 0, -1, 0));
+	__m256d prev, cur, next, vs, vnew, vnorm = _mm256_setzero_pd();
+	double lnorm = 0, val, lanes[4];
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int i;
+
+	if (N >= 8) {
+		prev = _mm256_loadu_pd(oth - 3);
+		cur = _mm256_loadu_pd(oth + 1);
+	} else {
+		prev = cur = _mm256_setzero_pd();
+	}
+	for (i = 1; i + 8 <= N; i += 4) {
+		next = _mm256_loadu_pd(oth + i + 4);
+		vs = _mm256_loadu_pd(self + i);
+		vnew = _mm256_add_pd(
+		       _mm256_shuffle_pd(_mm256_permute2f128_pd(prev, cur, 0x21),
+		                         cur, 0x5),
+		       _mm256_shuffle_pd(cur,
+		                         _mm256_permute2f128_pd(cur, next, 0x21),
+		                         0x5));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i - N));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i + N));
+		vnew = _mm256_mul_pd(vfour, vnew);
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i - N - 1));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i - N + 1));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i + N - 1));
+		vnew = _mm256_add_pd(vnew, _mm256_loadu_pd(oth + i + N + 1));
+		vnew = _mm256_sub_pd(vnew, _mm256_mul_pd(vtwenty, vs));
+		if (SOR_RHS_ARRAY == kind)
+			vnew = _mm256_sub_pd(vnew, _mm256_loadu_pd(rhs + i));
+		else if (SOR_RHS_CONST == kind)
+			vnew = _mm256_sub_pd(vnew, _mm256_set1_pd(r0));
+		vnew = _mm256_add_pd(vs, _mm256_mul_pd(vg20, vnew));
+		_mm256_storeu_pd(dst + i, _mm256_blendv_pd(
+		                 _mm256_loadu_pd(dst + i), vnew, mask));
+		if (track)
+			vnorm = addChange256(vnorm, _mm256_and_pd(mask,
+			        _mm256_sub_pd(vs, vnew)), track);
+		prev = cur;
+		cur = next;
+	}
+
+	if (i % 2 != p)
+		i++;
+	for (; i < N - 1; i += 2) {
+		val = compactAt(self, oth, rhs, i, N, g20, r0, kind);
+		if (track)
+			lnorm = addChange(lnorm, val - self[i], track);
+		dst[i] = val;
+	}
+
+	if (track) {
+		_mm256_storeu_pd(lanes, vnorm);
+		for (i = 0; i < 4; i++)
+			lnorm = (SOR_TRACK_SUM2 == track) ? lnorm + lanes[i]
+			        : ((lanes[i] > lnorm) ? lanes[i] : lnorm);
+	}
+
+	return lnorm;
+}
+
+
+/* Same as naturalAVX2() with 8 points at a time. */
+__attribute__((target("avx512f"), always_inline))
+static inline double naturalAVX512SpanT(double *dst, const double *self,
+                                        const double *oth, const double *rhs,
+                                        double gamma, int N, int p, int x0,
+                                        int x1, int track, int kind)
+{
+	const __m512d vgamma = _mm512_set1_pd(gamma);
+	const __m512d vfour = _mm512_set1_pd(4.);
+	const __m512d vquarter = _mm512_set1_pd(0.25);
+	const __m512i left = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 15);
+	const __m512i right = _mm512_set_epi64(8, 7, 6, 5, 4, 3, 2, 1);
+	const __mmask8 mask = p ? 0x55 : 0xAA;
+	__m512d prev, cur, next, vs, vnew, vnorm = _mm512_setzero_pd();
+	double lnorm = 0, diff, val;
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int i;
+
+	if (x1 + 1 - x0 >= 16) {
+		prev = _mm512_set1_pd(oth[x0 - 1]);
+		cur = _mm512_loadu_pd(oth + x0);
+	} else {
+		prev = cur = _mm512_setzero_pd();
+	}
+	for (i = x0; i + 16 <= x1 + 1; i += 8) {
+		next = _mm512_loadu_pd(oth + i + 8);
+		vs = _mm512_loadu_pd(self + i);
+		vnew = _mm512_add_pd(_mm512_permutex2var_pd(cur, left, prev),
+		                     _mm512_permutex2var_pd(cur, right, next));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i - N));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i + N));
+		vnew = _mm512_sub_pd(vnew, _mm512_mul_pd(vfour, vs));
+		if (SOR_RHS_ARRAY == kind)
+			vnew = _mm512_sub_pd(vnew, _mm512_loadu_pd(rhs + i));
+		else if (SOR_RHS_CONST == kind)
+			vnew = _mm512_sub_pd(vnew, _mm512_set1_pd(r0));
+		vnew = _mm512_mul_pd(_mm512_mul_pd(vgamma, vnew), vquarter);
+		vnew = _mm512_add_pd(vs, vnew);
+		_mm512_mask_storeu_pd(dst + i, mask, vnew);
+		if (track)
+			vnorm = addChange512(vnorm, mask, _mm512_sub_pd(vs, vnew),
+			                     track);
+		prev = cur;
+		cur = next;
+	}
+
+	if (i % 2 != p)
+		i++;
+	for (; i < x1; i += 2) {
+		val = self[i] +
+		      gamma * (oth[i-1] +
+		               oth[i+1] +
+		               oth[i-N] +
+		               oth[i+N] -
+		               4. * self[i] -
+		               rhsAt(rhs, i, r0, kind)) / 4.;
+		if (track)
+			lnorm = addChange(lnorm, val - self[i], track);
+		dst[i] = val;
+	}
+
+	if (SOR_TRACK_SUM2 == track) {
+		lnorm += _mm512_reduce_add_pd(vnorm);
+	} else if (track) {
+		diff = _mm512_reduce_max_pd(vnorm);
+		lnorm = (diff > lnorm) ? diff : lnorm;
+	}
+
+	return lnorm;
+}
+
+
+__attribute__((target("avx512f"), always_inline))
+static inline double naturalAVX512T(double *dst, const double *self,
+                                    const double *oth, const double *rhs,
+                                    double gamma, int N, int p, int track,
+                                    int kind)
+{
+	return naturalAVX512SpanT(dst, self, oth, rhs, gamma, N, p, 1, N - 1,
+	                          track, kind);
+}
+
+
+__attribute__((target("avx512f"), always_inline))
+static inline double redBlackAVX512T(double *dst, const double *self,
+                                     const double *oth, const double *rhs,
+                                     double gamma, int N, int p, int track,
+                                     int kind)
+{
+	const int W = (N + 1) / 2;
+	const int kmax = (N - 2 - p) / 2;
+	const double *side = oth + p - 1;
+	const __m512d vgamma = _mm512_set1_pd(gamma);
+	const __m512d vfour = _mm512_set1_pd(4.);
+	const __m512d vquarter = _mm512_set1_pd(0.25);
+	__m512d vs, vnew, vnorm = _mm512_setzero_pd();
+	double lnorm = 0, diff, val;
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int k;
+
+	for (k = 1 - p; k + 8 <= kmax + 1; k += 8) {
+		vs = _mm512_loadu_pd(self + k);
+		vnew = _mm512_add_pd(_mm512_loadu_pd(side + k),
+		                     _mm512_loadu_pd(side + k + 1));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + k - W));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + k + W));
+		vnew = _mm512_sub_pd(vnew, _mm512_mul_pd(vfour, vs));
+		if (SOR_RHS_ARRAY == kind)
+			vnew = _mm512_sub_pd(vnew, _mm512_loadu_pd(rhs + k));
+		else if (SOR_RHS_CONST == kind)
+			vnew = _mm512_sub_pd(vnew, _mm512_set1_pd(r0));
+		vnew = _mm512_mul_pd(_mm512_mul_pd(vgamma, vnew), vquarter);
+		vnew = _mm512_add_pd(vs, vnew);
+		_mm512_storeu_pd(dst + k, vnew);
+		if (track)
+			vnorm = addChange512(vnorm, 0xFF, _mm512_sub_pd(vs, vnew),
+			                     track);
+	}
+
+	for (; k <= kmax; k++) {
+		val = self[k] +
+		      gamma * (side[k] +
+		               side[k + 1] +
+		               oth[k - W] +
+		               oth[k + W] -
+		               4. * self[k] -
+		               rhsAt(rhs, k, r0, kind)) / 4.;
+		if (track)
+			lnorm = addChange(lnorm, val - self[k], track);
+		dst[k] = val;
+	}
+
+	if (SOR_TRACK_SUM2 == track) {
+		lnorm += _mm512_reduce_add_pd(vnorm);
+	} else if (track) {
+		diff = _mm512_reduce_max_pd(vnorm);
+		lnorm = (diff > lnorm) ? diff : lnorm;
+	}
+
+	return lnorm;
+}
+
+
+/* Same as compactAVX2T() with 8 points at a time. */
+__attribute__((target("avx512f"), always_inline))
+static inline double compactAVX512T(double *dst, const double *self,
+                                    const double *oth, const double *rhs,
+                                    double gamma, int N, int p, int track,
+                                    int kind)
+{
+	const double g20 = gamma / 20.;
+	const __m512d vg20 = _mm512_set1_pd(g20);
+	const __m512d vfour = _mm512_set1_pd(4.);
+	const __m512d vtwenty = _mm512_set1_pd(20.);
+	const __m512i left = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 15);
+	const __m512i right = _mm512_set_epi64(8, 7, 6, 5, 4, 3, 2, 1);
+	const __mmask8 mask = p ? 0x55 : 0xAA;
+	__m512d prev, cur, next, vs, vnew, vnorm = _mm512_setzero_pd();
+	double lnorm = 0, diff, val;
+	const double r0 = (SOR_RHS_CONST == kind) ? rhs[0] : 0.;
+	int i;
+
+	if (N >= 16) {
+		prev = _mm512_loadu_pd(oth - 7);
+		cur = _mm512_loadu_pd(oth + 1);
+	} else {
+		prev = cur = _mm512_setzero_pd();
+	}
+	for (i = 1; i + 16 <= N; i += 8) {
+		next = _mm512_loadu_pd(oth + i + 8);
+		vs = _mm512_loadu_pd(self + i);
+		vnew = _mm512_add_pd(_mm512_permutex2var_pd(cur, left, prev),
+		                     _mm512_permutex2var_pd(cur, right, next));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i - N));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i + N));
+		vnew = _mm512_mul_pd(vfour, vnew);
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i - N - 1));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i - N + 1));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i + N - 1));
+		vnew = _mm512_add_pd(vnew, _mm512_loadu_pd(oth + i + N + 1));
+		vnew = _mm512_sub_pd(vnew, _mm512_mul_pd(vtwenty, vs));
+		if (SOR_RHS_ARRAY == kind)
+			vnew = _mm512_sub_pd(vnew, _mm512_loadu_pd(rhs + i));
+		else if (SOR_RHS_CONST == kind)
+			vnew = _mm512_sub_pd(vnew, _mm512_set1_pd(r0));
+		vnew = _mm512_add_pd(vs, _mm512_mul_pd(vg20, vnew));
+		_mm512_storeu_pd(dst + i, _mm512_mask_blend_pd(mask,
+		                 _mm512_loadu_pd(dst + i), vnew));
+		if (track)
+			vnorm = addChange512(vnorm, mask, _mm512_sub_pd(vs, vnew),
+			                     track);
+		prev = cur;
+		cur = next;
+	}
+
+	if (i % 2 != p)
+		i++;
+	for (; i < N - 1; i += 2) {
+		val = compactAt(self, oth, rhs, i, N, g20, r0, kind);
+		if (track)
+			lnorm = addChange(lnorm, val - self[i], track);
+		dst[i] = val;
+	}
+
+	if (SOR_TRACK_SUM2 == track) {
+		lnorm += _mm512_reduce_add_pd(vnorm);
+	} else if (track) {
+		diff = _mm512_reduce_max_pd(vnorm);
+		lnorm = (diff > lnorm) ? diff : lnorm;
+	}
+
+	return lnorm;
+}
+
+
+/* Add the changes of 8 points to the per-lane norms */
+__attribute__((target("avx2")))
+static inline __m256 addChange256F(__m256 vnorm, __m256 vdiff, int track)
+{
+	if (SOR_TRACK_SUM2 == track)
+		return _mm256_add_ps(vnorm, _mm256_mul_ps(vdiff, vdiff));
+	return _mm256_max_ps(vnorm,
+	                     _mm256_andnot_ps(_mm256_set1_ps(-0.f), vdiff));
+}
+
+
+/* Same as redBlackAVX2() with 8 floats at a time. */
+__attribute__((target("avx2")))
+static float redBlackAVX2F(float *dst, const float *self,
+                           const float *oth, const float *rhs,
+                           float gamma, int N, int p, int track)
+{
+	const int W = (N + 1) / 2;
+	const int kmax = (N - 2 - p) / 2;
+	const float *side = oth + p - 1;
+	const __m256 vgamma = _mm256_set1_ps(gamma);
+	const __m256 vfour = _mm256_set1_ps(4.f);
+	const __m256 vquarter = _mm256_set1_ps(0.25f);
+	__m256 vs, vnew, vnorm = _mm256_setzero_ps();
+	float lnorm = 0, val, lanes[8];
+	int k;
+
+	for (k = 1 - p; k + 8 <= kmax + 1; k += 8) {
+		vs = _mm256_loadu_ps(self + k);
+		vnew = _mm256_add_ps(_mm256_loadu_ps(side + k),
+		                     _mm256_loadu_ps(side + k + 1));
+		vnew = _mm256_add_ps(vnew, _mm256_loadu_ps(oth + k - W));
+		vnew = _mm256_add_ps(vnew, _mm256_loadu_ps(oth + k + W));
+		vnew = _mm256_sub_ps(vnew, _mm256_mul_ps(vfour, vs));
+		vnew = _mm256_sub_ps(vnew, _mm256_loadu_ps(rhs + k));
+		vnew = _mm256_mul_ps(_mm256_mul_ps(vgamma, vnew), vquarter);
+		vnew = _mm256_add_ps(vs, vnew);
+		_mm256_storeu_ps(dst + k, vnew);
+		if (track)
+			vnorm = addChange256F(vnorm, _mm256_sub_ps(vs, vnew),
+			                      track);
+	}
+
+	for (; k <= kmax; k++) {
+		val = self[k] +
+		      gamma * (side[k] +
+		               side[k + 1] +
+		               oth[k - W] +
+		               oth[k + W] -
+		               4.f * self[k] -
+		               rhs[k]) / 4.f;
+		if (track)
+			lnorm = addChangeF(lnorm, val - self[k], track);
+		dst[k] = val;
+	}
+
+	if (track) {
+		_mm256_storeu_ps(lanes, vnorm);
+		for (k = 0; k < 8; k++)
+			lnorm = (SOR_TRACK_SUM2 == track) ? lnorm + lanes[k]
+			        : ((lanes[k] > lnorm) ? lanes[k] : lnorm);
+	}
+
+	return lnorm;
+}
+
+
+/* Same as redBlackAVX512() with 16 floats at a time. */
+__attribute__((target("avx512f")))
+static float redBlackAVX512F(float *dst, const float *self,
+                             const float *oth, const float *rhs,
+                             float gamma, int N, int p, int track)
+{
+	const int W = (N + 1) / 2;
+	const int kmax = (N - 2 - p) / 2;
+	const float *side = oth + p - 1;
+	const __m512 vgamma = _mm512_set1_ps(gamma);
+	const __m512 vfour = _mm512_set1_ps(4.f);
+	const __m512 vquarter = _mm512_set1_ps(0.25f);
+	__m512 vs, vnew, vdiff, vnorm = _mm512_setzero_ps();
+	float lnorm = 0, diff, val;
+	int k;
+
+	for (k = 1 - p; k + 16 <= kmax + 1; k += 16) {
+		vs = _mm512_loadu_ps(self + k);
+		vnew = _mm512_add_ps(_mm512_loadu_ps(side + k),
+		                     _mm512_loadu_ps(side + k + 1));
+		vnew = _mm512_add_ps(vnew, _mm512_loadu_ps(oth + k - W));
+		vnew = _mm512_add_ps(vnew, _mm512_loadu_ps(oth + k + W));
+		vnew = _mm512_sub_ps(vnew, _mm512_mul_ps(vfour, vs));
+		vnew = _mm512_sub_ps(vnew, _mm512_loadu_ps(rhs + k));
+		vnew = _mm512_mul_ps(_mm512_mul_ps(vgamma, vnew), vquarter);
+		vnew = _mm512_add_ps(vs, vnew);
+		_mm512_storeu_ps(dst + k, vnew);
+		if (SOR_TRACK_SUM2 == track) {
+			vdiff = _mm512_sub_ps(vs, vnew);
+			vnorm = _mm512_add_ps(vnorm, _mm512_mul_ps(vdiff, vdiff));
+		} else if (track) {
+			vnorm = _mm512_max_ps(vnorm,
+			        _mm512_abs_ps(_mm512_sub_ps(vs, vnew)));
+		}
+	}
+
+	for (; k <= kmax; k++) {
+		val = self[k] +
+		      gamma * (side[k] +
+		               side[k + 1] +
+		               oth[k - W] +
+		               oth[k + W] -
+		               4.f * self[k] -
+		               rhs[k]) / 4.f;
+		if (track)
+			lnorm = addChangeF(lnorm, val - self[k], track);
+		dst[k] = val;
+	}
+
+	if (SOR_TRACK_SUM2 == track) {
+		lnorm += _mm512_reduce_add_ps(vnorm);
+	} else if (track) {
+		diff = _mm512_reduce_max_ps(vnorm);
+		lnorm = (diff > lnorm) ? diff : lnorm;
+	}
+
+	return lnorm;
+}
+
+#endif
+
+
+/* Kernel of the signature SORRowKernel from the inlined body##T(), for one
+ * kind of RHS and one norm: the track argument is ignored */
+#define SOR_VARIANT(body, attr, kind, track) \
+attr static double body##_##kind##_##track(double *dst, const double *self, \
+		const double *oth, const double *rhs, double gamma, int N, \
+		int p, int t) \
+{ \
+	(void) t; \
+	return body##T(dst, self, oth, rhs, gamma, N, p, SOR_TRACK_##track, \
+	               SOR_RHS_##kind); \
+}
+
+
+/* All the variants of body##T() and their table body##Variants, indexed
+ * by SORRhs and SORTrack, and body(), which takes an array RHS and the norm
+ * at run time */
+#define SOR_VARIANTS(body, attr) \
+SOR_VARIANT(body, attr, ARRAY, NONE) \
+SOR_VARIANT(body, attr, ARRAY, MAX) \
+SOR_VARIANT(body, attr, ARRAY, SUM2) \
+SOR_VARIANT(body, attr, CONST, NONE) \
+SOR_VARIANT(body, attr, CONST, MAX) \
+SOR_VARIANT(body, attr, CONST, SUM2) \
+SOR_VARIANT(body, attr, ZERO, NONE) \
+SOR_VARIANT(body, attr, ZERO, MAX) \
+SOR_VARIANT(body, attr, ZERO, SUM2) \
+static const SORRowKernel body##Variants[SOR_RHS_KINDS][SOR_TRACKS] = { \
+	{body##_ARRAY_NONE, body##_ARRAY_MAX, body##_ARRAY_SUM2}, \
+	{body##_CONST_NONE, body##_CONST_MAX, body##_CONST_SUM2}, \
+	{body##_ZERO_NONE, body##_ZERO_MAX, body##_ZERO_SUM2} \
+}; \
+attr static double body(double *dst, const double *self, \
+		const double *oth, const double *rhs, double gamma, int N, \
+		int p, int track) \
+{ \
+	return body##T(dst, self, oth, rhs, gamma, N, p, track, \
+	               SOR_RHS_ARRAY); \
+}
+
+
+/* Kernel of the signature SORSpanKernel from body##SpanT(), for one kind
+ * of RHS */
+#define SOR_SPAN(body, attr, kind) \
+attr static double body##Span_##kind(double *dst, const double *self, \
+		const double *oth, const double *rhs, double gamma, int N, \
+		int p, int x0, int x1, int track) \
+{ \
+	return body##SpanT(dst, self, oth, rhs, gamma, N, p, x0, x1, track, \
+	                   SOR_RHS_##kind); \
+}
+
+
+/* The span kernels of body##SpanT() and their table body##Spans, indexed
+ * by SORRhs */
+#define SOR_SPANS(body, attr) \
+SOR_SPAN(body, attr, ARRAY) \
+SOR_SPAN(body, attr, CONST) \
+SOR_SPAN(body, attr, ZERO) \
+static const SORSpanKernel body##Spans[SOR_RHS_KINDS] = { \
+	body##Span_ARRAY, body##Span_CONST, body##Span_ZERO \
+};
+
+
+SOR_VARIANTS(naturalScalar, )
+SOR_VARIANTS(redBlackScalar, )
+SOR_SPANS(naturalScalar, )
+SOR_VARIANTS(compactScalar, )
+#ifdef HAVE_X86_SIMD
+SOR_VARIANTS(naturalAVX2, __attribute__((target("avx2"))))
+SOR_VARIANTS(redBlackAVX2, __attribute__((target("avx2"))))
+SOR_SPANS(naturalAVX2, __attribute__((target("avx2"))))
+SOR_VARIANTS(compactAVX2, __attribute__((target("avx2"))))
+SOR_VARIANTS(naturalAVX512, __attribute__((target("avx512f"))))
+SOR_VARIANTS(redBlackAVX512, __attribute__((target("avx512f"))))
+SOR_SPANS(naturalAVX512, __attribute__((target("avx512f"))))
+SOR_VARIANTS(compactAVX512, __attribute__((target("avx512f"))))
+#endif
+
+
+/* indexed by SORKernel - 1 */
+static const SORKernels kernels[] = {
+	{SOR_KERNEL_SCALAR, "scalar", naturalScalar, redBlackScalar,
+	 redBlackScalarF, naturalScalarVariants, redBlackScalarVariants,
+	 naturalScalarSpans, compactScalar, compactScalarVariants},
+#ifdef HAVE_X86_SIMD
+	{SOR_KERNEL_AVX2, "avx2", naturalAVX2, redBlackAVX2, redBlackAVX2F,
+	 naturalAVX2Variants, redBlackAVX2Variants, naturalAVX2Spans,
+	 compactAVX2, compactAVX2Variants},
+	{SOR_KERNEL_AVX512, "avx512", naturalAVX512, redBlackAVX512,
+	 redBlackAVX512F, naturalAVX512Variants, redBlackAVX512Variants,
+	 naturalAVX512Spans, compactAVX512, compactAVX512Variants},
+#endif
+};
+
+
+const SORKernels *selectSORKernels(SORKernel want)
+{
+	SORKernel best = SOR_KERNEL_SCALAR;
+
+	#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		best = SOR_KERNEL_AVX512;
+	else if (__builtin_cpu_supports("avx2"))
+		best = SOR_KERNEL_AVX2;
+	#endif
+
+	if ((SOR_KERNEL_AUTO == want) || (want > best))
+		want = best;
+
+	return &kernels[want - SOR_KERNEL_SCALAR];
+}
@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Row kernels of the SOR sweeps, with SIMD versions picked at runtime.
+ *
+ * The sweeps in PoissonSOR2D.c update the grid one row of one color at a
+ * time through these kernels. Besides the plain C version there are AVX2
+ * and AVX-512 versions. selectSORKernels() picks the widest one the CPU
+ * supports, so the same binary runs on every x86-64 machine. The kernels of
+ * the split red-black layout also come in single precision, with twice the
+ * points per instruction.
+ *
+ * This file is compiled by the host C compiler and without -march=native,
+ * see src/Makefile: only the SIMD kernels themselves are built for AVX2 or
+ * AVX-512.
+ */
+
+#ifndef POISSONSOR2D_SIMD_H_INCLUDED
+#define POISSONSOR2D_SIMD_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** @brief Instruction set of the sweep kernels. */
+typedef enum {
+	SOR_KERNEL_AUTO = 0, /**< best one supported by the CPU */
+	SOR_KERNEL_SCALAR,   /**< plain C, runs everywhere */
+	SOR_KERNEL_AVX2,     /**< AVX2, 4 points per instruction */
+	SOR_KERNEL_AVX512    /**< AVX-512F, 8 points per instruction */
+} SORKernel;
+
+
+/** @brief Norm of the changes computed by a row kernel. */
+typedef enum {
+	SOR_TRACK_NONE = 0, /**< no norm, the cheapest kernel */
+	SOR_TRACK_MAX,      /**< largest change of a point */
+	SOR_TRACK_SUM2,     /**< sum of the squared changes */
+	SOR_TRACKS
+} SORTrack;
+
+
+/** @brief Kind of RHS a row kernel is specialized for.
+ *
+ * The solver scans the RHS before a solve and, when it is the same at
+ * every interior point, runs kernels that do not load it.
+ */
+typedef enum {
+	SOR_RHS_ARRAY = 0, /**< any RHS, read from the array */
+	SOR_RHS_CONST,     /**< the same value at every point, read once */
+	SOR_RHS_ZERO,      /**< Laplace's equation, no RHS at all */
+	SOR_RHS_KINDS
+} SORRhs;
+
+
+/** @brief Update one row of one color. Not to be called by user.
+ *
+ * Applies the SOR step to the points of parity p on one interior row and
+ * returns the norm of the changes selected by track, see SORTrack.
+ *
+ * dst, self and rhs point to the start of the row. oth is the array the
+ * four neighbors are read from, also at the start of the row. For the
+ * natural layout all of them are N wide and the points are x = 2 - p,
+ * 4 - p, ... up to N - 2. For the split red-black layout they point into
+ * half-grids of width (N + 1) / 2, see toRedBlack(), and p is the parity of
+ * x on the row.
+ *
+ * The compact kernels, for the 9-point stencil of SOR_STENCIL_9, only run on
+ * the natural layout and also read the four corners from oth.
+ *
+ * dst and self may be the same array.
+ *
+ * The kernels of SORKernels::naturalRHS, SORKernels::redblackRHS and
+ * SORKernels::compactRHS are specialized for a kind of RHS and a norm, and
+ * ignore track. For SOR_RHS_CONST, rhs points to the one value of the RHS;
+ * for SOR_RHS_ZERO it is not read.
+ *
+ * @return largest |dst - self| or sum of (dst - self)^2 over the row, or 0
+ */
+typedef double (*SORRowKernel)(double *dst, /**< [out] updated row */
+                               const double *self, /**< [in] old values */
+                               const double *oth, /**< [in] neighbors */
+                               const double *rhs, /**< [in] scaled RHS */
+                               double gamma, /**< [in] SOR parameter */
+                               int N, /**< [in] grid size */
+                               int p, /**< [in] parity of x on the row */
+                               int track /**< [in] norm, see SORTrack */);
+
+
+/** @brief Update part of one row of one color. Not to be called by user.
+ *
+ * Same as SORRowKernel on the natural layout, for the points of parity p
+ * in [x0, x1) only, 1 <= x0 < x1 <= N - 1 and x0 odd. oth is only read in
+ * [x0 - 1, x1] and dst only written at the points of parity p in [x0, x1),
+ * so the spans of one color can be swept by several threads at once.
+ */
+typedef double (*SORSpanKernel)(double *dst, /**< [out] updated row */
+                                const double *self, /**< [in] old values */
+                                const double *oth, /**< [in] neighbors */
+                                const double *rhs, /**< [in] scaled RHS */
+                                double gamma, /**< [in] SOR parameter */
+                                int N, /**< [in] grid size */
+                                int p, /**< [in] parity of x on the row */
+                                int x0, /**< [in] first x, odd */
+                                int x1, /**< [in] x past the last one */
+                                int track /**< [in] norm, see SORTrack */);
+
+
+/** @brief Update one row of one color in single precision. Not to be
+ * called by user.
+ *
+ * Same as SORRowKernel on the split red-black layout, with float values.
+ * There is no version for the natural layout.
+ */
+typedef float (*SORRowKernelF)(float *dst, /**< [out] updated row */
+                               const float *self, /**< [in] old values */
+                               const float *oth, /**< [in] neighbors */
+                               const float *rhs, /**< [in] scaled RHS */
+                               float gamma, /**< [in] SOR parameter */
+                               int N, /**< [in] grid size */
+                               int p, /**< [in] parity of x on the row */
+                               int track /**< [in] norm, see SORTrack */);
+
+
+/** @brief Set of row kernels for one instruction set. */
+typedef struct {
+	SORKernel id;          /**< instruction set */
+	const char *name;      /**< name for printing */
+	SORRowKernel natural;  /**< kernel for the natural layout */
+	SORRowKernel redblack; /**< kernel for the split red-black layout */
+	SORRowKernelF redblack32; /**< same in single precision */
+	/** natural kernels by [SORRhs][SORTrack] */
+	const SORRowKernel (*naturalRHS)[SOR_TRACKS];
+	/** split red-black kernels by [SORRhs][SORTrack] */
+	const SORRowKernel (*redblackRHS)[SOR_TRACKS];
+	/** natural kernels on part of a row by SORRhs */
+	const SORSpanKernel *naturalSpan;
+	/** kernel of the compact 9-point stencil on the natural layout */
+	SORRowKernel compact;
+	/** compact kernels by [SORRhs][SORTrack] */
+	const SORRowKernel (*compactRHS)[SOR_TRACKS];
+} SORKernels;
+
+
+/** @brief Get the row kernels for an instruction set.
+ *
+ * SOR_KERNEL_AUTO checks the CPU (CPUID) and returns the widest kernels it
+ * can run. Asking for an instruction set the CPU or the compiler does not
+ * support falls back to the next narrower one.
+ *
+ * @return kernels, never NULL
+ */
+const SORKernels *selectSORKernels(SORKernel want /**< [in] instruction set */);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
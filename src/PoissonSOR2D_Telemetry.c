@@ -0,0 +1,355 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Telemetry of the CPU SOR solver.
+ *
+ */
+
+
+#include "PoissonSOR2D_Telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/* State of one thread of the solve. Each step adds to the slot of its
+ * parity, so the master can record a step while the others are in the
+ * next one. The padding keeps the threads off each other's cache lines. */
+typedef struct {
+	char pad0[64];
+	double last;                    /* time of the last mark */
+	uint64_t count[SOR_COUNTERS];   /* counters at the last mark */
+	int fd[SOR_COUNTERS];           /* counters, -1 when not open */
+	int step;                       /* steps of this solve */
+	double time[2][SOR_PHASES];
+	uint64_t counters[2][SOR_PHASES][SOR_COUNTERS];
+	char pad1[64];
+} SORTelemetryThread;
+
+
+struct SORTelemetry {
+	SORTelemetryRecord *ring;
+	int size;     /* records in ring */
+	int count;    /* records made, the last at (count - 1) % size */
+	int flags;
+	int nthreads; /* threads with a state */
+	int warned;   /* the counters could not be opened */
+	SORTelemetryThread *thr;
+};
+
+
+static const char *phaseName[SOR_PHASES] = {
+	"black", "red", "step", "reduce", "sync"
+};
+
+
+SORTelemetry *openSORTelemetry(int size, int flags)
+{
+	#ifndef SOR_TELEMETRY
+	(void) size;
+	(void) flags;
+	fprintf(stderr, "Telemetry not built in, build with TELEMETRY=1\n");
+	return NULL;
+	#else
+	SORTelemetry *tel;
+	int nthreads = 1;
+
+	#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+	#endif
+	if (!(tel = (SORTelemetry *) calloc(1, sizeof(SORTelemetry)))) {
+		perror("Telemetry allocation error:");
+		return NULL;
+	}
+	tel->ring = (SORTelemetryRecord *) malloc((size > 0 ? size : 1) *
+	                                          sizeof(SORTelemetryRecord));
+	tel->thr = (SORTelemetryThread *) calloc(nthreads,
+	                                         sizeof(SORTelemetryThread));
+	if ((NULL == tel->ring) || (NULL == tel->thr)) {
+		perror("Telemetry arrays allocation error:");
+		closeSORTelemetry(tel);
+		return NULL;
+	}
+	tel->size = (size > 0) ? size : 1;
+	tel->flags = flags;
+	tel->nthreads = nthreads;
+
+	return tel;
+	#endif
+}
+
+
+int getSORTelemetry(const SORTelemetry *tel, SORTelemetryRecord *rec, int n)
+{
+	int i, first;
+
+	if (NULL == tel)
+		return 0;
+
+	if (n > tel->count)
+		n = tel->count;
+	if (n > tel->size)
+		n = tel->size;
+	first = tel->count - n;
+	for (i = 0; i < n; i++)
+		rec[i] = tel->ring[(first + i) % tel->size];
+
+	return n;
+}
+
+
+int writeSORTelemetry(const SORTelemetry *tel, const char *fname)
+{
+	const SORTelemetryRecord *r;
+	char path[256];
+	FILE *fp;
+	double wall;
+	uint64_t miss;
+	int i, p, k, n, counters;
+
+	if (NULL == tel)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s.csv", fname);
+	if (!(fp = fopen(path, "w"))) {
+		perror("Unable to write files");
+		return 1;
+	}
+	counters = tel->flags & SOR_TELEMETRY_COUNTERS;
+
+	fprintf(fp, "step,sweeps,check,norm");
+	for (p = 0; p < SOR_PHASES; p++) {
+		fprintf(fp, ",%s_s,%s_imb", phaseName[p], phaseName[p]);
+		if (counters)
+			fprintf(fp, ",%s_cycles,%s_instr,%s_llc", phaseName[p],
+			        phaseName[p], phaseName[p]);
+	}
+	fprintf(fp, counters ? ",llc_gbs\n" : "\n");
+
+	n = (tel->count < tel->size) ? tel->count : tel->size;
+	for (i = tel->count - n; i < tel->count; i++) {
+		r = tel->ring + i % tel->size;
+		fprintf(fp, "%d,%d,%d,%.9e", r->step, r->sweeps, r->check,
+		        r->norm);
+		wall = 0.;
+		miss = 0;
+		for (p = 0; p < SOR_PHASES; p++) {
+			fprintf(fp, ",%.9e,%.3f", r->time[p], r->imbalance[p]);
+			if (counters)
+				for (k = 0; k < SOR_COUNTERS; k++)
+					fprintf(fp, ",%llu", (unsigned long long)
+					        r->counters[p][k]);
+			wall += r->time[p];
+			miss += r->counters[p][SOR_COUNTER_LLC_MISS];
+		}
+		if (counters)
+			fprintf(fp, ",%.3f", (wall > 0.) ? 64. * miss / wall / 1.E9
+			                                 : 0.);
+		fprintf(fp, "\n");
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+
+void closeSORTelemetry(SORTelemetry *tel)
+{
+	if (NULL == tel)
+		return;
+
+	free(tel->ring);
+	free(tel->thr);
+	free(tel);
+}
+
+
+#ifdef SOR_TELEMETRY
+
+/* Wall time in seconds */
+static inline double telNow(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1.E9;
+}
+
+
+/* State of the calling thread, or NULL when the solve is not recorded */
+static inline SORTelemetryThread *telThread(SORTelemetry *tel, int *tid,
+                                            int *nth)
+{
+	*tid = 0;
+	*nth = 1;
+	#ifdef _OPENMP
+	*tid = omp_get_thread_num();
+	*nth = omp_get_num_threads();
+	#endif
+
+	if ((NULL == tel) || (*nth > tel->nthreads))
+		return NULL;
+	return tel->thr + *tid;
+}
+
+
+/* Counters of the calling thread as one group, all read at once. Leaves
+ * th->fd[0] at -1 when the kernel refuses them. */
+static void openCounters(SORTelemetryThread *th)
+{
+	static const uint64_t config[SOR_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES
+	};
+	struct perf_event_attr attr;
+	int k, j;
+
+	for (k = 0; k < SOR_COUNTERS; k++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = config[k];
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.disabled = (0 == k);
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		th->fd[k] = (int) syscall(__NR_perf_event_open, &attr, 0, -1,
+		                          (0 == k) ? -1 : th->fd[0], 0);
+		if (th->fd[k] < 0) {
+			for (j = k - 1; j >= 0; j--)
+				close(th->fd[j]);
+			th->fd[0] = -1;
+			return;
+		}
+	}
+
+	ioctl(th->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+
+/* Reads the counters into val, 0 on success */
+static inline int readCounters(const SORTelemetryThread *th, uint64_t *val)
+{
+	uint64_t buf[1 + SOR_COUNTERS];
+
+	if (read(th->fd[0], buf, sizeof(buf)) != (ssize_t) sizeof(buf))
+		return 1;
+	memcpy(val, buf + 1, sizeof(uint64_t) * SOR_COUNTERS);
+
+	return 0;
+}
+
+
+void beginTelemetry(SORTelemetry *tel)
+{
+	SORTelemetryThread *th;
+	int tid, nth;
+
+	if (!(th = telThread(tel, &tid, &nth)))
+		return;
+
+	th->step = 0;
+	memset(th->time, 0, sizeof(th->time));
+	memset(th->counters, 0, sizeof(th->counters));
+	th->fd[0] = -1;
+	if (tel->flags & SOR_TELEMETRY_COUNTERS) {
+		openCounters(th);
+		if ((th->fd[0] < 0) && (0 == tid) && !tel->warned) {
+			perror("Hardware counters not available");
+			tel->warned = 1;
+		}
+		if ((th->fd[0] >= 0) && readCounters(th, th->count))
+			memset(th->count, 0, sizeof(th->count));
+	}
+	th->last = telNow();
+}
+
+
+void endTelemetry(SORTelemetry *tel)
+{
+	SORTelemetryThread *th;
+	int tid, nth, k;
+
+	if (!(th = telThread(tel, &tid, &nth)) || (th->fd[0] < 0))
+		return;
+
+	for (k = SOR_COUNTERS - 1; k >= 0; k--)
+		close(th->fd[k]);
+	th->fd[0] = -1;
+}
+
+
+void markTelemetry(SORTelemetry *tel, SORPhase phase)
+{
+	SORTelemetryThread *th;
+	uint64_t val[SOR_COUNTERS];
+	double t;
+	int tid, nth, s, k;
+
+	if (!(th = telThread(tel, &tid, &nth)))
+		return;
+
+	s = th->step % 2;
+	t = telNow();
+	th->time[s][phase] += t - th->last;
+	th->last = t;
+	if ((th->fd[0] >= 0) && !readCounters(th, val))
+		for (k = 0; k < SOR_COUNTERS; k++) {
+			th->counters[s][phase][k] += val[k] - th->count[k];
+			th->count[k] = val[k];
+		}
+}
+
+
+void stepTelemetry(SORTelemetry *tel, int sweeps, int check, double norm)
+{
+	SORTelemetryThread *th;
+	SORTelemetryRecord *r;
+	double tmax, tsum;
+	int tid, nth, s, p, k, i;
+
+	if (!(th = telThread(tel, &tid, &nth)))
+		return;
+
+	/* the wait at the barrier goes to the next step */
+	s = th->step % 2;
+	th->step++;
+	markTelemetry(tel, SOR_PHASE_SYNC);
+	if (0 != tid)
+		return;
+
+	r = tel->ring + tel->count % tel->size;
+	r->step = tel->count;
+	r->sweeps = sweeps;
+	r->check = check;
+	r->norm = check ? norm : 0.;
+	for (p = 0; p < SOR_PHASES; p++) {
+		tmax = tsum = 0.;
+		for (k = 0; k < SOR_COUNTERS; k++)
+			r->counters[p][k] = 0;
+		for (i = 0; i < nth; i++) {
+			th = tel->thr + i;
+			tmax = (th->time[s][p] > tmax) ? th->time[s][p] : tmax;
+			tsum += th->time[s][p];
+			th->time[s][p] = 0.;
+			for (k = 0; k < SOR_COUNTERS; k++) {
+				r->counters[p][k] += th->counters[s][p][k];
+				th->counters[s][p][k] = 0;
+			}
+		}
+		r->time[p] = tmax;
+		r->imbalance[p] = (tsum > 0.) ? tmax * nth / tsum : 0.;
+	}
+	tel->count++;
+}
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Telemetry of the CPU SOR solver.
+ *
+ * A SORTelemetry keeps one record per step of the solve in a ring buffer
+ * allocated when it is opened: the sweeps, the norm if the step ended with
+ * a check, the time of each phase of the step and how unequal the threads
+ * were in it. It can also read hardware counters of each thread around the
+ * phases with perf_event_open(2).
+ *
+ * The hooks in the solver only exist when the code is built with
+ * SOR_TELEMETRY defined (make TELEMETRY=1); otherwise they compile to
+ * nothing and openSORTelemetry() returns NULL.
+ *
+ */
+
+#ifndef POISSONSOR2D_TELEMETRY_H_INCLUDED
+#define POISSONSOR2D_TELEMETRY_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief Part of a step of the solver timed on its own. */
+typedef enum {
+	SOR_PHASE_BLACK = 0, /**< sweep of the black points */
+	SOR_PHASE_RED,       /**< sweep of the red points */
+	/** wavefront or Chebyshev step, whose colors are not apart */
+	SOR_PHASE_STEP,
+	SOR_PHASE_REDUCE,    /**< norm of a check: residual and joining */
+	SOR_PHASE_SYNC,      /**< waits at barriers and snapshot copies */
+	SOR_PHASES
+} SORPhase;
+
+
+/** @brief Hardware counters read with SOR_TELEMETRY_COUNTERS. */
+typedef enum {
+	SOR_COUNTER_CYCLES = 0, /**< CPU cycles */
+	SOR_COUNTER_INSTR,      /**< instructions retired */
+	SOR_COUNTER_LLC_MISS,   /**< last level cache misses */
+	SOR_COUNTERS
+} SORCounter;
+
+
+/** @brief Flag of openSORTelemetry(): also read the hardware counters. */
+#define SOR_TELEMETRY_COUNTERS 1
+
+
+/** @brief What the solver did in one step.
+ *
+ * The times are of each thread on its own, without the waits at barriers,
+ * which go to SOR_PHASE_SYNC. The wait at the barrier that ends a step
+ * counts in the next one.
+ */
+typedef struct {
+	int step;   /**< steps recorded before this one */
+	int sweeps; /**< sweeps done at the end of the step */
+	int check;  /**< 1 if the step ended with a check */
+	double norm; /**< norm of the check, 0 without one */
+	/** seconds of the phase in the slowest thread */
+	double time[SOR_PHASES];
+	/** time of the slowest thread over the mean time of the threads, 1
+	 * when balanced, 0 when the phase did not run */
+	double imbalance[SOR_PHASES];
+	/** counters of the phase summed over the threads */
+	uint64_t counters[SOR_PHASES][SOR_COUNTERS];
+} SORTelemetryRecord;
+
+
+/** @brief Start recording the telemetry of the solves.
+ *
+ * Allocates the ring buffer of size records and the state of
+ * omp_get_max_threads() threads; solves with more threads are not
+ * recorded. Once the buffer is full each record replaces the oldest one.
+ * Give it to PoissonSOR2DRHS() in SOROptions::telemetry; the records of
+ * the solves that get it follow each other.
+ *
+ * With SOR_TELEMETRY_COUNTERS in flags, each thread opens its counters at
+ * the start of each solve and reads them at the end of each phase, one
+ * system call each time. When the kernel refuses the counters, see
+ * /proc/sys/kernel/perf_event_paranoid, the solve goes on without them.
+ *
+ * @return the telemetry, or NULL on memory error or when built without
+ * SOR_TELEMETRY
+ */
+SORTelemetry *openSORTelemetry(int size, /**< [in] records kept */
+                               int flags /**< [in] 0 or SOR_TELEMETRY_COUNTERS */);
+
+
+/** @brief Copy the last records, the oldest first.
+ *
+ * @return the number of records copied, at most n
+ */
+int getSORTelemetry(const SORTelemetry *tel, /**< [in] telemetry */
+                    SORTelemetryRecord *rec, /**< [out] n records */
+                    int n /**< [in] most records to copy */);
+
+
+/** @brief Write the records kept to the CSV file fname.csv.
+ *
+ * One line per step, oldest first, with the time and imbalance of each
+ * phase. With the counters, also the counters of each phase and the memory
+ * bandwidth of the step estimated from the last level cache misses, one
+ * cache line of 64 bytes each.
+ *
+ * @return
+ * * 0 on success
+ * * 1 on file error
+ */
+int writeSORTelemetry(const SORTelemetry *tel, /**< [in] telemetry */
+                      const char *fname /**< [in] path, without .csv */);
+
+
+/** @brief Free a telemetry. */
+void closeSORTelemetry(SORTelemetry *tel /**< [in] telemetry, or NULL */);
+
+
+#ifdef SOR_TELEMETRY
+
+/* Hooks of the solver. All take a NULL telemetry and then do nothing. */
+
+/* Called by each thread of the solve at its start and at its end */
+void beginTelemetry(SORTelemetry *tel);
+void endTelemetry(SORTelemetry *tel);
+/* Called by each thread at the end of a phase: the time since its last
+ * mark, and the counters, go to phase */
+void markTelemetry(SORTelemetry *tel, SORPhase phase);
+/* Called by each thread at the end of a step, right after a barrier and
+ * without marks since it; the master thread records the step */
+void stepTelemetry(SORTelemetry *tel, int sweeps, int check, double norm);
+
+#define SOR_TEL_BEGIN(tel) beginTelemetry(tel)
+#define SOR_TEL_END(tel) endTelemetry(tel)
+#define SOR_TEL_MARK(tel, phase) markTelemetry(tel, phase)
+#define SOR_TEL_STEP(tel, sweeps, check, norm) \
+	stepTelemetry(tel, sweeps, check, norm)
+
+#else
+
+#define SOR_TEL_BEGIN(tel) ((void) 0)
+#define SOR_TEL_END(tel) ((void) 0)
+#define SOR_TEL_MARK(tel, phase) ((void) 0)
+#define SOR_TEL_STEP(tel, sweeps, check, norm) ((void) 0)
+
+#endif
+
+
+#endif
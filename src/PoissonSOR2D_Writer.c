@@ -0,0 +1,164 @@
+/*
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Background writer of snapshots of the solution.
+ *
+ */
+
+
+#include "PoissonSOR2D_Writer.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The buffers go from the solver (filling) to the thread (pending, then
+ * busy) and back. Each index is -1 when no buffer is in that state; the
+ * solver fills the buffer that is not busy, so it never waits. */
+struct SORWriter {
+	char fname[240];
+	int N;
+	double *buf[2];
+	SORStats st[2];
+	int filling, pending, busy;
+	int stop;
+	SORWriterStats stats;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_t thread;
+};
+
+
+static void *writerLoop(void *arg);
+
+
+SORWriter *openSORWriter(const char *fname, int N)
+{
+	SORWriter *w;
+	const size_t n = (size_t) N * N;
+
+	if (!(w = (SORWriter *) calloc(1, sizeof(SORWriter)))) {
+		perror("Writer allocation error:");
+		return NULL;
+	}
+	if (!(w->buf[0] = (double *) malloc(2 * n * sizeof(double)))) {
+		perror("Snapshot arrays allocation error:");
+		free(w);
+		return NULL;
+	}
+	w->buf[1] = w->buf[0] + n;
+	snprintf(w->fname, sizeof(w->fname), "%s", fname);
+	w->N = N;
+	w->filling = w->pending = w->busy = -1;
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->wake, NULL);
+	if (pthread_create(&w->thread, NULL, writerLoop, w)) {
+		perror("Writer thread error:");
+		pthread_cond_destroy(&w->wake);
+		pthread_mutex_destroy(&w->lock);
+		free(w->buf[0]);
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+
+double *beginSnapshot(SORWriter *w)
+{
+	int b;
+
+	pthread_mutex_lock(&w->lock);
+	/* the buffer that is neither busy nor pending, else the pending one */
+	if (-1 == w->busy)
+		b = (0 == w->pending) ? 1 : 0;
+	else
+		b = 1 - w->busy;
+	if (b == w->pending) {
+		w->pending = -1;
+		w->stats.dropped++;
+	}
+	w->filling = b;
+	pthread_mutex_unlock(&w->lock);
+
+	return w->buf[b];
+}
+
+
+void commitSnapshot(SORWriter *w, const SORStats *stats)
+{
+	pthread_mutex_lock(&w->lock);
+	w->st[w->filling] = *stats;
+	/* an older snapshot still waiting is replaced by this one */
+	if (-1 != w->pending)
+		w->stats.dropped++;
+	w->pending = w->filling;
+	w->filling = -1;
+	w->stats.taken++;
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->lock);
+}
+
+
+int closeSORWriter(SORWriter *w, SORWriterStats *stats)
+{
+	int failed;
+
+	if (NULL == w)
+		return 0;
+
+	pthread_mutex_lock(&w->lock);
+	w->stop = 1;
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	if (NULL != stats)
+		*stats = w->stats;
+	failed = w->stats.failed;
+
+	pthread_cond_destroy(&w->wake);
+	pthread_mutex_destroy(&w->lock);
+	free(w->buf[0]);
+	free(w);
+
+	return failed ? -1 : 0;
+}
+
+
+/* Writer thread: writes the pending buffer until stopped, and the last
+ * pending one after that */
+static void *writerLoop(void *arg)
+{
+	SORWriter *w = (SORWriter *) arg;
+	char filen[256];
+	int b, ret;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while ((-1 == w->pending) && !w->stop)
+			pthread_cond_wait(&w->wake, &w->lock);
+		if (-1 == w->pending)
+			break;
+		b = w->busy = w->pending;
+		w->pending = -1;
+		pthread_mutex_unlock(&w->lock);
+
+		snprintf(filen, sizeof(filen), "%s_%07d", w->fname,
+		         w->st[b].sweeps);
+		ret = writeToFileBin(filen, w->N, w->buf[b], &w->st[b]);
+
+		pthread_mutex_lock(&w->lock);
+		w->busy = -1;
+		if (ret)
+			w->stats.failed++;
+		else
+			w->stats.written++;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
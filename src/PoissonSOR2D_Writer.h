@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Background writer of snapshots of the solution.
+ *
+ * A SORWriter owns a thread that writes snapshots of the grid with
+ * writeToFileBin() while the solver keeps sweeping. It has two buffers of
+ * N x N points: the thread writes one while the solver fills the other.
+ * When the disk falls behind, a new snapshot replaces the one still waiting
+ * to be written instead of waiting for the thread, so taking a snapshot
+ * costs the solver one copy of the grid and never waits for the disk.
+ *
+ */
+
+#ifndef POISSONSOR2D_WRITER_H_INCLUDED
+#define POISSONSOR2D_WRITER_H_INCLUDED
+
+#include "PoissonSOR2D.h"
+
+
+/** @brief What a SORWriter did, filled by closeSORWriter(). */
+typedef struct {
+	int taken;   /**< snapshots given by the solver */
+	int written; /**< snapshots written to disk */
+	int dropped; /**< snapshots replaced by a newer one before written */
+	int failed;  /**< snapshots whose file could not be written */
+} SORWriterStats;
+
+
+/** @brief Start a background writer.
+ *
+ * Allocates the two snapshot buffers and starts the writer thread. The
+ * snapshot taken after sweep t is written to "fname_t.bin", with t padded
+ * to 7 digits.
+ *
+ * @return the writer, or NULL on memory or thread error
+ */
+SORWriter *openSORWriter(const char *fname, /**< [in] prefix of the files */
+                         int N /**< [in] grid size in each dimension */);
+
+
+/** @brief Buffer for the next snapshot.
+ *
+ * Returns the N x N buffer the caller fills with the grid, f[x + y * N],
+ * before calling commitSnapshot(). When one buffer is being written and
+ * the other one still waits to be written, the waiting snapshot is dropped
+ * and its buffer returned. Does not wait for the writer thread.
+ */
+double *beginSnapshot(SORWriter *w /**< [in, out] writer */);
+
+
+/** @brief Hand the buffer of beginSnapshot() to the writer thread. */
+void commitSnapshot(SORWriter *w, /**< [in, out] writer */
+                    const SORStats *stats /**< [in] sweeps done, in the file
+                                             name, and the last check */);
+
+
+/** @brief Stop a background writer.
+ *
+ * Waits for the writer thread to write the snapshot waiting to be written,
+ * if any, and frees the writer.
+ *
+ * @return
+ * * 0 on success
+ * * -1 if a snapshot could not be written
+ */
+int closeSORWriter(SORWriter *w, /**< [in] writer */
+                   SORWriterStats *stats /**< [out] counts, or NULL */);
+
+
+#endif
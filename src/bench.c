@@ -0,0 +1,198 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Benchmark of the CPU SOR sweeps.
+ *
+ * Runs a fixed number of sweeps with the plain sweep order and with
+ * temporal blocking (SOROptions::wavefront) of increasing depth, and
+ * reports the time per sweep and the speedup over the plain sweeps. The
+ * solutions are compared with the plain one, they must be the same.
+ * Before that, every kernel is compared with the scalar one on grids too
+ * small for its vectors.
+ */
+
+#include <stdio.h>
+#include "PoissonSOR2D.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <time.h>
+
+
+/** @brief Boundary condition of main.c and an initial guess. */
+static void initGrid(double *f, int N)
+{
+	int i;
+	double x0 = N/2.;
+
+	memset(f, 0, (size_t) N * N * sizeof(double));
+	for (i = 0; i < N; i++)
+		f[i*N] = -(i - x0)*(i - x0) / (x0)/(x0) + 1.;
+}
+
+
+/** @brief Wall time of sweeps sweeps, in seconds. */
+static double timeSweeps(double *f, const double *rhs, int N, int sweeps,
+                         const SOROptions *opts)
+{
+	struct timespec t0, t1;
+
+	initGrid(f, N);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	/* prec = 0 never stops early */
+	PoissonSOR2DRHS(f, rhs, SORParamSin(N), N, sweeps, 0., opts);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1.E9;
+}
+
+
+/** @brief Largest difference of the kernels to the scalar one on small
+ * grids.
+ *
+ * Runs a few sweeps with every kernel the CPU has, on both layouts and
+ * with the compact stencil, for N = 3 to 9. The rows are at most two vectors long, so the vector kernels
+ * run mostly their scalar remainder, and must give the same values.
+ */
+static double checkSmallGrids(void)
+{
+	SOROptions opts;
+	double *f, *ref, *rhs, diff = 0.;
+	int N, i, k, layout, stencil;
+
+	for (N = 3; N <= 9; N++) {
+		f = (double *) malloc((size_t) N * N * sizeof(double));
+		ref = (double *) malloc((size_t) N * N * sizeof(double));
+		rhs = (double *) malloc((size_t) N * N * sizeof(double));
+		if ((NULL == f) || (NULL == ref) || (NULL == rhs)) {
+			perror("Memory allocation problem: ");
+			free(f);
+			free(ref);
+			free(rhs);
+			return -1.;
+		}
+		for (i = 0; i < N * N; i++)
+			rhs[i] = (i % 7) / 100.;
+
+		/* layout 2 is the natural one with the compact stencil */
+		for (layout = 0; layout < 3; layout++)
+		for (k = SOR_KERNEL_SCALAR; k <= SOR_KERNEL_AVX512; k++) {
+			if ((int) selectSORKernels((SORKernel) k)->id != k)
+				continue;
+			initSOROptions(&opts);
+			opts.kernel = (SORKernel) k;
+			stencil = (2 == layout);
+			opts.layout = stencil ? SOR_LAYOUT_NATURAL
+			                      : (SORLayout) layout;
+			opts.stencil = stencil ? SOR_STENCIL_9 : SOR_STENCIL_5;
+			opts.log = NULL;
+			initGrid(f, N);
+			PoissonSOR2DRHS(f, rhs, 1.5, N, 10, 0., &opts);
+			if (SOR_KERNEL_SCALAR == k)
+				memcpy(ref, f, (size_t) N * N * sizeof(double));
+			for (i = 0; i < N * N; i++)
+				diff = (fabs(f[i] - ref[i]) > diff) ?
+				       fabs(f[i] - ref[i]) : diff;
+		}
+
+		free(f);
+		free(ref);
+		free(rhs);
+	}
+
+	return diff;
+}
+
+
+/** @brief Main function.
+ *
+ * Command line interface of the benchmark.
+ */
+int main(int argc, char *argv[])
+{
+	int c;
+	int i, depth;
+	int N = 4096;
+	int sweeps = 48;
+	int maxdepth = 16;
+	double *f = NULL, *ref = NULL, *rhs = NULL;
+	double plain, time, diff;
+	SOROptions opts;
+
+	initSOROptions(&opts);
+
+	/* Parse command line*/
+	while ((c = getopt(argc, argv, "N:s:w:rh")) >= 0) {
+		switch (c) {
+		case 'N':
+			N = atoi(optarg);
+			break;
+
+		case 's':
+			sweeps = atoi(optarg);
+			break;
+
+		case 'w':
+			maxdepth = atoi(optarg);
+			break;
+
+		case 'r':
+			opts.layout = SOR_LAYOUT_REDBLACK;
+			break;
+
+		case '?':
+		case 'h':
+			fprintf(stderr, "Usage: %s [option]...\n"
+				"Options:\n"
+				"\t-N\tgrid size in each dimension\n"
+				"\t-s\tnumber of sweeps\n"
+				"\t-w\tlargest wavefront depth\n"
+				"\t-r\tsweep on split red-black storage\n"
+				"\t-h\tthis text\n",
+				argv[0]);
+			return 0;
+		}
+	}
+
+	if (!(f = (double*) malloc((size_t) N*N * sizeof(double))) ||
+	    !(ref = (double*) malloc((size_t) N*N * sizeof(double))) ||
+	    !(rhs = (double*) calloc((size_t) N*N, sizeof(double)))) {
+		perror("Memory allocation problem: ");
+		free(f);
+		free(ref);
+		return 1;
+	}
+
+	printf("kernels on N = 3 to 9, max diff to scalar: %.3g\n",
+	       checkSmallGrids());
+	printf("grid size: %d x %d, sweeps: %d, kernel: %s\n", N, N, sweeps,
+	       selectSORKernels(opts.kernel)->name);
+	printf("%6s %10s %12s %10s %8s %10s\n", "depth", "time", "time/sweep",
+	       "MLUP/s", "speedup", "max diff");
+
+	for (depth = 1; depth <= maxdepth; depth *= 2) {
+		opts.wavefront = depth;
+		time = timeSweeps(f, rhs, N, sweeps, &opts);
+
+		if (1 == depth) {
+			plain = time;
+			memcpy(ref, f, (size_t) N * N * sizeof(double));
+		}
+
+		diff = 0;
+		for (i = 0; i < N * N; i++)
+			diff = (fabs(f[i] - ref[i]) > diff) ? fabs(f[i] - ref[i]) : diff;
+
+		printf("%6d %10.4f %12.6f %10.1f %8.2f %10.3g\n", depth, time,
+		       time / sweeps, (double) (N-2) * (N-2) * sweeps / time / 1.E6,
+		       plain / time, diff);
+	}
+
+	free(f);
+	free(ref);
+	free(rhs);
+	return 0;
+}
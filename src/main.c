@@ -8,8 +8,15 @@
 
 #include <stdio.h>
 #include "PoissonSOR2D.h"
+#include "PoissonSOR2D_Writer.h"
+#include "PoissonSOR2D_Telemetry.h"
+#include "PoissonMG2D.h"
+#include "PoissonPCG2D.h"
+#include "PoissonDST2D.h"
+#include "PoissonSOR2D_Mixed.h"
 #include "PoissonSOR2D_CUDA.h"
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <time.h>
@@ -44,6 +51,20 @@ int main(int argc, char *argv[])
 	double prec = 0.1e-5;
 	double gamma;
 	double *f = NULL;
+	double *rhs = NULL;
+	SOROptions opts;
+	SORStats stats;
+	MGOptions mgopts;
+	int multigrid = 0;
+	int pcg = 0;
+	int dst = 0;
+	int mixed = 0;
+	int gamma_set = 0;
+	int text = 0;
+	SORWriterStats wstats;
+	SORStats restart;
+	const char *restart_file = NULL;
+	int telemetry = 0;
 
 	struct timespec t0, t1;
 	double serial_time;
@@ -51,11 +72,14 @@ int main(int argc, char *argv[])
 
 	double *f_gpu = NULL;
 
-	/* this SOR Parameter function is weird */
-	gamma = SORParamSin(N);
+	initSOROptions(&opts);
+	initMGOptions(&mgopts);
+	opts.stats = &stats;
+	stats.sweeps = 0;
+	stats.norm = 0.;
 
 	/* Parse command line*/
-	while ((c = getopt(argc, argv, "N:t:p:g:h")) >= 0) {
+	while ((c = getopt(argc, argv, "N:t:p:g:rw:ac:G:n:MCDSFTs:R:P:H9h")) >= 0) {
 		switch (c) {
 		case 'N':
 			N = (unsigned int) atoi(optarg);
@@ -71,11 +95,85 @@ int main(int argc, char *argv[])
 
 		case 'g':
 			gamma = atof(optarg);
+			gamma_set = 1;
 			if ((gamma < 0) || (gamma > 2))
 				fprintf(stdout, "Weird value of SOR parameter."
 				        "Be carefull.\n%s\n", optarg);
 			break;
 
+		case 'r':
+			opts.layout = SOR_LAYOUT_REDBLACK;
+			break;
+
+		case 'w':
+			opts.wavefront = atoi(optarg);
+			break;
+
+		case 'a':
+			opts.adaptive = 1;
+			break;
+
+		case 'c':
+			opts.check.every = atoi(optarg);
+			break;
+
+		case 'G':
+			opts.check.growth = atof(optarg);
+			break;
+
+		case 'n':
+			if (!strcmp(optarg, "l2"))
+				opts.check.norm = SOR_NORM_L2;
+			else if (!strcmp(optarg, "res"))
+				opts.check.norm = SOR_NORM_RESIDUAL;
+			else
+				opts.check.norm = SOR_NORM_MAX;
+			break;
+
+		case 'M':
+			multigrid = 1;
+			break;
+
+		case 'C':
+			pcg = 1;
+			break;
+
+		case 'D':
+			dst = 1;
+			break;
+
+		case 'S':
+			opts.accel = SOR_ACCEL_CHEBYSHEV;
+			break;
+
+		case 'F':
+			mixed = 1;
+			break;
+
+		case 'T':
+			text = 1;
+			break;
+
+		case 's':
+			opts.snapshot = atoi(optarg);
+			break;
+
+		case 'R':
+			restart_file = optarg;
+			break;
+
+		case 'P':
+			telemetry = atoi(optarg);
+			break;
+
+		case 'H':
+			opts.alloc = SOR_ALLOC_HUGE;
+			break;
+
+		case '9':
+			opts.stencil = SOR_STENCIL_9;
+			break;
+
 		case '?':
 		case 'h':
 			fprintf(stderr, "Usage: %s [option]...\n"
@@ -84,19 +182,66 @@ int main(int argc, char *argv[])
 				"\t-t\tmax number of iterations\n"
 				"\t-p\tdesired precision\n"
 				"\t-g\tdesired SOR parameter\n"
+				"\t-r\tsweep on split red-black storage\n"
+				"\t-w\tsweeps per pass over the grid\n"
+				"\t-a\testimate the SOR parameter in CPU\n"
+				"\t\tduring the solve, starting from -g\n"
+				"\t-c\tsweeps before the first convergence check\n"
+				"\t-G\tgrowth of the interval between checks\n"
+				"\t-n\tnorm of the checks: max, l2 or res\n"
+				"\t-M\tsolve with multigrid in CPU, -t is\n"
+				"\t\tthe max number of V-cycles\n"
+				"\t-C\tsolve with conjugate gradients and SSOR\n"
+				"\t\tin CPU, -g is also the SSOR parameter\n"
+				"\t-D\tsolve directly with the sine transform\n"
+				"\t\tin CPU, no iterations\n"
+				"\t-S\tsolve with Chebyshev accelerated SSOR\n"
+				"\t\tin CPU, -g is also the SSOR parameter\n"
+				"\t-F\tsolve with SOR in single precision and\n"
+				"\t\trefinement in double in CPU\n"
+				"\t-T\twrite the solutions as text, .sol files\n"
+				"\t-s\twrite a snapshot every this many sweeps\n"
+				"\t\tof the CPU SOR, in the background\n"
+				"\t-R\tstart from the solution in this file,\n"
+				"\t\t.bin or .sol, of any grid size\n"
+				"\t-P\trecord each step of the CPU SOR in\n"
+				"\t\ttelemetry.csv: 1 times, 2 also hardware\n"
+				"\t\tcounters; needs make TELEMETRY=1\n"
+				"\t-H\tput the CPU grids on huge pages\n"
+				"\t-9\tsolve the fourth order compact 9-point\n"
+				"\t\tstencil with SOR in CPU, -r, -w and -S\n"
+				"\t\tare ignored there\n"
 				"\t-h\tthis text\n",
 				argv[0]);
 			return 0;
 		}
 	}
 
+	/* this SOR Parameter function is weird */
+	if (!gamma_set)
+		gamma = SORParamSin(N);
+
 	printf("Simulation parameters:\n");
 	printf("\tgrid size: %d x %d\n", N, N);
 	printf("\ttmax: %d\n", tmax);
 	printf("\tprecision: %f\n", prec);
 	printf("\tgamma: %f\n", gamma);
+	printf("\tlayout: %s\n", (SOR_LAYOUT_REDBLACK == opts.layout) ?
+	       "red-black" : "natural");
+	printf("\tkernel: %s\n", selectSORKernels(opts.kernel)->name);
+	printf("\tsweeps per pass: %d\n", opts.wavefront);
+	printf("\tadaptive SOR parameter: %s\n", opts.adaptive ? "yes" : "no");
+	printf("\tconvergence check: every %d sweeps, growth %g, norm %s\n",
+	       opts.check.every, opts.check.growth,
+	       (SOR_NORM_L2 == opts.check.norm) ? "l2" :
+	       (SOR_NORM_RESIDUAL == opts.check.norm) ? "res" : "max");
+	printf("\tCPU solver: %s\n", multigrid ? "multigrid" :
+	       pcg ? "PCG-SSOR" : dst ? "sine transform" : mixed ? "mixed precision SOR" :
+	       (SOR_STENCIL_9 == opts.stencil) ? "SOR, compact 9-point stencil" :
+	       (SOR_ACCEL_CHEBYSHEV == opts.accel) ? "Chebyshev-SSOR" : "SOR");
 
-	if (!(f = (double*) calloc(N*N, sizeof(double)))) {
+	/* the CPU grids are placed by the threads that sweep them */
+	if (!(f = allocGrid(N, opts.alloc))) {
 		perror("Memory allocation problem: ");
 		return 1;
 	}
@@ -105,6 +250,13 @@ int main(int argc, char *argv[])
 		free(f);
 		return 1;
 	}
+	if (!(rhs = allocGrid(N, opts.alloc))) {
+		perror("Memory allocation problem: ");
+		free(f);
+		free(f_gpu);
+		return 1;
+	}
+	fillRHS(rhs, func, N);
 
 	/* set boundary conditions */
 	/* x = 0: f = -y^2 */
@@ -114,13 +266,82 @@ int main(int argc, char *argv[])
 		f_gpu[i*N] = f[i*N];
 	}
 
+	/* start from a previous solution, after the boundary is set */
+	if (NULL != restart_file) {
+		if (readFromFile(restart_file, N, f, &restart)) {
+			fprintf(stderr, "Unable to restart from %s\n",
+			        restart_file);
+			free(f);
+			free(f_gpu);
+			free(rhs);
+			return 1;
+		}
+		memcpy(f_gpu, f, N * N * sizeof(double));
+		opts.start = restart.sweeps;
+		opts.resume = &restart;
+		printf("Restart from %s: sweeps %d, check interval %d, "
+		       "norm %.9f\n", restart_file, restart.sweeps,
+		       restart.interval, restart.norm);
+	}
+
+	if ((opts.snapshot > 0) && !(opts.writer = openSORWriter("snap", N))) {
+		free(f);
+		free(f_gpu);
+		free(rhs);
+		return 1;
+	}
+
+	/* without the hooks built in it is NULL and the solve goes on */
+	if (telemetry > 0)
+		opts.telemetry = openSORTelemetry(1 << 16, (telemetry > 1) ?
+		                                  SOR_TELEMETRY_COUNTERS : 0);
+
 	/* run in CPU and measure time*/
 
 	clock_gettime(CLOCK_REALTIME, &t0);
-	i = PoissonSOR2D(f, func, gamma, N, tmax, prec);
+	if (multigrid) {
+		mgopts.kernel = opts.kernel;
+		mgopts.alloc = opts.alloc;
+		i = PoissonMG2DRHS(f, rhs, N, tmax, prec, &mgopts);
+	} else if (pcg) {
+		i = PoissonPCG2DRHS(f, rhs, gamma_set ? gamma : SSORParamPCG(N),
+		                    N, tmax, prec, &opts);
+	} else if (dst) {
+		i = PoissonDST2DRHS(f, rhs, N, &opts);
+	} else if (mixed) {
+		i = PoissonSOR2DMixed(f, rhs, gamma, N, tmax, prec, &opts);
+	} else if (SOR_STENCIL_9 == opts.stencil) {
+		i = PoissonSOR2DRHS(f, rhs, gamma_set ? gamma : SORParam9(N),
+		                    N, tmax, prec, &opts);
+	} else if (SOR_ACCEL_CHEBYSHEV == opts.accel) {
+		i = PoissonSOR2DRHS(f, rhs, gamma_set ? gamma : SSORParamCheb(N),
+		                    N, tmax, prec, &opts);
+	} else {
+		i = PoissonSOR2DRHS(f, rhs, gamma, N, tmax, prec, &opts);
+	}
 	clock_gettime(CLOCK_REALTIME, &t1);
 
-	writeToFile("cpu", N, f, NULL);
+	if (stats.sweeps > 0)
+		printf("CPU sweeps: %d, checks: %d, last check interval: %d\n",
+		       stats.sweeps, stats.checks, stats.interval);
+
+	if (NULL != opts.writer) {
+		closeSORWriter(opts.writer, &wstats);
+		printf("Snapshots: %d taken, %d written, %d dropped, %d failed\n",
+		       wstats.taken, wstats.written, wstats.dropped,
+		       wstats.failed);
+	}
+
+	if (NULL != opts.telemetry) {
+		if (!writeSORTelemetry(opts.telemetry, "telemetry"))
+			printf("Telemetry written to telemetry.csv\n");
+		closeSORTelemetry(opts.telemetry);
+	}
+
+	if (text)
+		writeToFile("cpu", N, f, NULL);
+	else
+		writeToFileBin("cpu", N, f, &stats);
 
 	serial_time = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1.E9;
 
@@ -130,7 +351,10 @@ int main(int argc, char *argv[])
 	i = PoissonSOR2D_CUDA(f_gpu, gamma, N, tmax, prec);
 	clock_gettime(CLOCK_REALTIME, &t1);
 
-	writeToFile("gpu", N, f, NULL);
+	if (text)
+		writeToFile("gpu", N, f, NULL);
+	else
+		writeToFileBin("gpu", N, f, NULL);
 
 	gpu_time = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1.E9;
 
@@ -138,5 +362,6 @@ int main(int argc, char *argv[])
 
 	free(f);
 	free(f_gpu);
+	free(rhs);
 	return 0;
 }
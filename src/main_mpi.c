@@ -0,0 +1,179 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief CLI for solving a 2D Poisson equation with Dirichlet's condition
+ * on MPI ranks.
+ *
+ * Same problem as main.c, solved by PoissonSOR2DMPIRHS(). Run it with
+ * mpirun, for example mpirun -np 4 ./2DSOR_mpi -N 512.
+ */
+
+#include <stdio.h>
+#include "PoissonSOR2D_MPI.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+
+/** @brief RHS of Poisson Equation, the one of main.c. */
+static double g(int x, int y, int N)
+{
+	(void) x;
+	(void) y;
+	(void) N;
+	return 0.;
+}
+
+
+/** @brief Boundary condition of main.c. */
+static void initGrid(double *f, int N)
+{
+	int i;
+	double x0 = N/2.;
+
+	memset(f, 0, (size_t) N * N * sizeof(double));
+	for (i = 0; i < N; i++)
+		f[i*N] = -(i - x0)*(i - x0) / (x0)/(x0) + 1.;
+}
+
+
+/** @brief Main function.
+ *
+ * Command line interface of the MPI solver. Only rank 0 prints and writes
+ * the solution.
+ */
+int main(int argc, char *argv[])
+{
+	int c;
+	int i, rank, nranks, ret, verify = 0, gamma_set = 0;
+	int N = 128;
+	int tmax = 4200;
+	double prec = 0.1e-5;
+	double gamma;
+	double *f = NULL, *ref = NULL, *rhs = NULL;
+	double t0, time, diff;
+	SOROptions opts;
+	SORStats stats;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+	initSOROptions(&opts);
+	opts.stats = &stats;
+
+	/* Parse command line*/
+	while ((c = getopt(argc, argv, "N:t:p:g:c:G:vh")) >= 0) {
+		switch (c) {
+		case 'N':
+			N = atoi(optarg);
+			break;
+
+		case 't':
+			tmax = atoi(optarg);
+			break;
+
+		case 'p':
+			prec = atof(optarg);
+			break;
+
+		case 'g':
+			gamma = atof(optarg);
+			gamma_set = 1;
+			break;
+
+		case 'c':
+			opts.check.every = atoi(optarg);
+			break;
+
+		case 'G':
+			opts.check.growth = atof(optarg);
+			break;
+
+		case 'v':
+			verify = 1;
+			break;
+
+		case '?':
+		case 'h':
+			if (0 == rank)
+				fprintf(stderr, "Usage: %s [option]...\n"
+					"Options:\n"
+					"\t-N\tgrid size in each dimension\n"
+					"\t-t\tmax number of iterations\n"
+					"\t-p\tdesired precision\n"
+					"\t-g\tdesired SOR parameter\n"
+					"\t-c\tsweeps before the first convergence check\n"
+					"\t-G\tgrowth of the interval between checks\n"
+					"\t-v\tcompare with the solver of one process\n"
+					"\t-h\tthis text\n",
+					argv[0]);
+			MPI_Finalize();
+			return 0;
+		}
+	}
+
+	if (!gamma_set)
+		gamma = SORParamSin(N);
+
+	if (0 == rank) {
+		printf("Simulation parameters:\n");
+		printf("\tgrid size: %d x %d\n", N, N);
+		printf("\ttmax: %d\n", tmax);
+		printf("\tprecision: %f\n", prec);
+		printf("\tgamma: %f\n", gamma);
+		printf("\tkernel: %s\n", selectSORKernels(opts.kernel)->name);
+		printf("\tconvergence check: every %d sweeps, growth %g\n",
+		       opts.check.every, opts.check.growth);
+		printf("\tMPI processes: %d\n", nranks);
+	}
+
+	f = (double *) malloc((size_t) N * N * sizeof(double));
+	rhs = (double *) malloc((size_t) N * N * sizeof(double));
+	if ((NULL == f) || (NULL == rhs)) {
+		perror("Memory allocation problem: ");
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	fillRHS(rhs, g, N);
+	initGrid(f, N);
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	t0 = MPI_Wtime();
+	ret = PoissonSOR2DMPIRHS(f, rhs, gamma, N, tmax, prec, MPI_COMM_WORLD,
+	                         &opts);
+	time = MPI_Wtime() - t0;
+
+	if (2 == ret && 0 == rank)
+		fprintf(stderr, "Too many processes for N = %d\n", N);
+
+	if ((0 == ret) && (0 == rank)) {
+		printf("MPI sweeps: %d, checks: %d, last check interval: %d\n",
+		       stats.sweeps, stats.checks, stats.interval);
+		printf("MPI_time: %f\n", time);
+		writeToFileBin("mpi", N, f, &stats);
+
+		if (verify) {
+			if (!(ref = (double *) malloc((size_t) N * N *
+			                              sizeof(double)))) {
+				perror("Memory allocation problem: ");
+				MPI_Abort(MPI_COMM_WORLD, 1);
+			}
+			initGrid(ref, N);
+			opts.stats = NULL;
+			PoissonSOR2DRHS(ref, rhs, gamma, N, tmax, prec, &opts);
+			diff = 0.;
+			for (i = 0; i < N * N; i++)
+				diff = fmax(diff, fabs(f[i] - ref[i]));
+			/* the sweeps are the same, so is the result */
+			printf("max difference to one process: %g\n", diff);
+			free(ref);
+		}
+	}
+
+	free(f);
+	free(rhs);
+	MPI_Finalize();
+	return ret;
+}
@@ -6,13 +6,36 @@ import numpy as np
 
 import argparse
 
+# header of the binary files of writeToFileBin(), see SORFileHeader. The
+# files are read as little endian, the byte order of x86 machines.
+HEADER = np.dtype([('magic', 'S8'), ('version', '<i4'), ('N', '<i4'),
+                   ('dtype', '<i4'), ('layout', '<i4'), ('sweeps', '<i4'),
+                   ('reserved', '<i4'), ('norm', '<f8'), ('pad', 'V24')])
+DTYPES = {0: '<f8', 1: '<f4'}
+
+def readsol(fname):
+        """Solution in fname, mapped without copies if it is binary."""
+        with open(fname, 'rb') as fp:
+                magic = fp.read(8)
+
+        if magic != b'SOR2DBIN':
+                return np.loadtxt(fname), None
+
+        head = np.fromfile(fname, dtype=HEADER, count=1)[0]
+        N = int(head['N'])
+        data = np.memmap(fname, dtype=DTYPES[int(head['dtype'])], mode='r',
+                         offset=HEADER.itemsize, shape=(N, N))
+        return data, head
+
 def plotter(fname, outname):
         fig = plt.figure()
         ax = fig.gca(projection='3d')
         
-        a = np.genfromtxt(fname, comments='  ', usecols=3)
-        N = int(a)
-        data = np.loadtxt(fname)
+        data, head = readsol(fname)
+        N = data.shape[0]
+        if head is not None:
+                print('N = %d, sweeps = %d, norm = %g' % (N, head['sweeps'],
+                                                          head['norm']))
         
         x = np.arange(0, N)
         y = np.arange(0, N)
@@ -0,0 +1,375 @@
+/**
+ * @file
+ * @author	Heitor Pascoal de Bittencourt <heitor.bittencourt@gmail.com>
+ *
+ * @brief Benchmark suite of the CPU SOR solver.
+ *
+ * Runs the solver over all the combinations of the given grid sizes,
+ * thread counts, kernels, layouts and SOR parameters. For each one it
+ * times a fixed number of sweeps, for the throughput, and a solve from zero
+ * to the given precision, for the time to convergence. The throughput is
+ * also given as memory bandwidth, from the bytes a sweep must move at
+ * least, next to the bandwidth of a STREAM triad measured at the start.
+ * The results are written as CSV or JSON, one record per combination.
+ */
+
+#include <stdio.h>
+#include "PoissonSOR2D.h"
+#include "PoissonSOR2D_SIMD.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <time.h>
+
+
+/** @brief Most values in one list option. */
+#define SUITE_MAX_LIST 16
+
+
+/** @brief One combination and what was measured for it. */
+typedef struct {
+	int N;
+	int threads;
+	SORKernel kernel;
+	SORLayout layout;
+	SORRhs rhs;        /**< RHS the row kernels are specialized for */
+	double gamma;
+	int sweeps;        /**< sweeps of the throughput run */
+	double time;       /**< seconds of the throughput run */
+	int conv_sweeps;   /**< sweeps to converge, or tmax */
+	double conv_time;  /**< seconds to converge */
+} SuiteResult;
+
+
+/** @brief Wall time in seconds. */
+static double now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1.E9;
+}
+
+
+/** @brief Boundary condition of main.c and an initial guess. */
+static void initGrid(double *f, int N)
+{
+	int i;
+	double x0 = N/2.;
+
+	memset(f, 0, (size_t) N * N * sizeof(double));
+	for (i = 0; i < N; i++)
+		f[i*N] = -(i - x0)*(i - x0) / (x0)/(x0) + 1.;
+}
+
+
+/** @brief Parse a comma separated list of numbers.
+ *
+ * @return number of values read
+ */
+static int parseList(const char *arg, double *vals)
+{
+	char *end;
+	int n = 0;
+
+	while ((n < SUITE_MAX_LIST) && *arg) {
+		vals[n++] = strtod(arg, &end);
+		if ((end == arg) || ((*end != ',') && (*end != '\0')))
+			return n - 1;
+		arg = (*end == ',') ? end + 1 : end;
+	}
+
+	return n;
+}
+
+
+/** @brief Bandwidth of a STREAM triad a = b + s c, in GB/s.
+ *
+ * Counts 24 bytes per element as STREAM does, best of 5 runs. n should be
+ * well above the size of the last level cache.
+ */
+static double streamTriad(size_t n)
+{
+	double *a, *b, *c, t, best = 1.E30;
+	const double s = 3.;
+	size_t i;
+	int k;
+
+	a = (double *) malloc(n * sizeof(double));
+	b = (double *) malloc(n * sizeof(double));
+	c = (double *) malloc(n * sizeof(double));
+	if ((NULL == a) || (NULL == b) || (NULL == c)) {
+		perror("STREAM arrays allocation error:");
+		free(a);
+		free(b);
+		free(c);
+		return 0.;
+	}
+
+	#pragma omp parallel for
+	for (i = 0; i < n; i++) {
+		a[i] = 0.;
+		b[i] = 1.;
+		c[i] = 2.;
+	}
+
+	for (k = 0; k < 5; k++) {
+		t = now();
+		#pragma omp parallel for
+		for (i = 0; i < n; i++)
+			a[i] = b[i] + s * c[i];
+		t = now() - t;
+		best = (t < best) ? t : best;
+	}
+
+	free(a);
+	free(b);
+	free(c);
+	return 24. * n / best / 1.E9;
+}
+
+
+/** @brief Bytes a sweep must move at least, per interior point.
+ *
+ * Each color reads and writes the grid and reads the RHS, unless the
+ * kernels for a constant or zero RHS skip it. In the natural layout the
+ * cache lines hold both colors, so each color moves the whole arrays: 3 x 8
+ * bytes per point and color, 2 x 8 without the RHS. In the split layout it
+ * moves its own half-grids and reads the other color: 4 x 4 bytes, 3 x 4
+ * without the RHS.
+ */
+static double sweepBytes(SORLayout layout, SORRhs rhs)
+{
+	const double arrays = (SOR_RHS_ARRAY == rhs) ? 3. : 2.;
+
+	return (SOR_LAYOUT_REDBLACK == layout) ? 8. * (arrays + 1.)
+	                                       : 16. * arrays;
+}
+
+
+/** @brief Write one result as CSV or JSON. */
+static void printResult(FILE *fp, const SuiteResult *r, double stream,
+                        int json, int first)
+{
+	const double pts = (double) (r->N - 2) * (r->N - 2);
+	const double gbs = sweepBytes(r->layout, r->rhs) * pts * r->sweeps /
+	                   r->time / 1.E9;
+
+	if (json) {
+		fprintf(fp, "%s\n  {\"N\": %d, \"threads\": %d, \"kernel\": \"%s\", "
+		        "\"layout\": \"%s\", \"gamma\": %.6f, \"sweeps\": %d, "
+		        "\"time_s\": %.6f, \"sweeps_per_s\": %.3f, "
+		        "\"mlups\": %.3f, \"gbs\": %.3f, \"stream_gbs\": %.3f, "
+		        "\"stream_frac\": %.3f, \"conv_sweeps\": %d, "
+		        "\"conv_time_s\": %.6f}",
+		        first ? "" : ",", r->N, r->threads,
+		        selectSORKernels(r->kernel)->name,
+		        (SOR_LAYOUT_REDBLACK == r->layout) ? "redblack" : "natural",
+		        r->gamma, r->sweeps, r->time, r->sweeps / r->time,
+		        pts * r->sweeps / r->time / 1.E6, gbs, stream,
+		        (stream > 0.) ? gbs / stream : 0., r->conv_sweeps,
+		        r->conv_time);
+		return;
+	}
+
+	if (first)
+		fprintf(fp, "N,threads,kernel,layout,gamma,sweeps,time_s,"
+		        "sweeps_per_s,mlups,gbs,stream_gbs,stream_frac,"
+		        "conv_sweeps,conv_time_s\n");
+	fprintf(fp, "%d,%d,%s,%s,%.6f,%d,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%.6f\n",
+	        r->N, r->threads, selectSORKernels(r->kernel)->name,
+	        (SOR_LAYOUT_REDBLACK == r->layout) ? "redblack" : "natural",
+	        r->gamma, r->sweeps, r->time, r->sweeps / r->time,
+	        pts * r->sweeps / r->time / 1.E6, gbs, stream,
+	        (stream > 0.) ? gbs / stream : 0., r->conv_sweeps, r->conv_time);
+}
+
+
+/** @brief Main function.
+ *
+ * Command line interface of the benchmark suite.
+ */
+int main(int argc, char *argv[])
+{
+	int c;
+	double Ns[SUITE_MAX_LIST] = {129, 513, 2049};
+	double threads[SUITE_MAX_LIST] = {1};
+	double kernels[SUITE_MAX_LIST] = {SOR_KERNEL_SCALAR, SOR_KERNEL_AVX2,
+	                                  SOR_KERNEL_AVX512};
+	double layouts[SUITE_MAX_LIST] = {SOR_LAYOUT_NATURAL,
+	                                  SOR_LAYOUT_REDBLACK};
+	double gammas[SUITE_MAX_LIST] = {0.};
+	int nN = 3, nthr = 1, nkern = 3, nlay = 2, ngam = 1;
+	int in, it, ik, il, ig, first = 1, json = 0;
+	int sweeps = 0, tmax = 100000;
+	double prec = 1.E-6, stream, t;
+	size_t stream_n = (size_t) 1 << 24;
+	const char *outname = NULL;
+	FILE *out;
+	double *f = NULL, *rhs = NULL;
+	SOROptions opts;
+	SORStats stats;
+	SuiteResult r;
+
+	#ifdef _OPENMP
+	threads[0] = omp_get_max_threads();
+	#endif
+
+	/* Parse command line*/
+	while ((c = getopt(argc, argv, "N:T:k:l:g:s:t:p:S:o:jh")) >= 0) {
+		switch (c) {
+		case 'N':
+			nN = parseList(optarg, Ns);
+			break;
+
+		case 'T':
+			nthr = parseList(optarg, threads);
+			break;
+
+		case 'k':
+			nkern = parseList(optarg, kernels);
+			break;
+
+		case 'l':
+			nlay = parseList(optarg, layouts);
+			break;
+
+		case 'g':
+			ngam = parseList(optarg, gammas);
+			break;
+
+		case 's':
+			sweeps = atoi(optarg);
+			break;
+
+		case 't':
+			tmax = atoi(optarg);
+			break;
+
+		case 'p':
+			prec = atof(optarg);
+			break;
+
+		case 'S':
+			stream_n = (size_t) atol(optarg);
+			break;
+
+		case 'o':
+			outname = optarg;
+			break;
+
+		case 'j':
+			json = 1;
+			break;
+
+		case '?':
+		case 'h':
+			fprintf(stderr, "Usage: %s [option]...\n"
+				"Options, lists are comma separated:\n"
+				"\t-N\tlist of grid sizes\n"
+				"\t-T\tlist of thread counts (OpenMP builds)\n"
+				"\t-k\tlist of kernels: 1 scalar, 2 avx2, 3 avx512\n"
+				"\t-l\tlist of layouts: 0 natural, 1 red-black\n"
+				"\t-g\tlist of SOR parameters, 0 for SORParamSin()\n"
+				"\t-s\tsweeps of the throughput runs, 0 for about\n"
+				"\t\t1E9 point updates\n"
+				"\t-t\tmax number of sweeps to converge\n"
+				"\t-p\tprecision to converge to\n"
+				"\t-S\tdoubles per array of the STREAM triad\n"
+				"\t-o\toutput file, standard output by default\n"
+				"\t-j\twrite JSON instead of CSV\n"
+				"\t-h\tthis text\n",
+				argv[0]);
+			return 0;
+		}
+	}
+
+	/* the results go to the standard output and the progress of the
+	 * suite to stderr */
+	out = outname ? fopen(outname, "w") : stdout;
+	if (NULL == out) {
+		perror("Unable to write files");
+		return 1;
+	}
+
+	stream = streamTriad(stream_n);
+	fprintf(stderr, "STREAM triad: %.2f GB/s\n", stream);
+
+	if (json)
+		fprintf(out, "{\"stream_gbs\": %.3f, \"results\": [", stream);
+
+	for (in = 0; in < nN; in++) {
+		r.N = (int) Ns[in];
+		f = (double *) malloc((size_t) r.N * r.N * sizeof(double));
+		rhs = (double *) calloc((size_t) r.N * r.N, sizeof(double));
+		if ((NULL == f) || (NULL == rhs)) {
+			perror("Memory allocation problem: ");
+			free(f);
+			free(rhs);
+			return 1;
+		}
+		/* Laplace's equation, swept by the kernels without RHS */
+		r.rhs = SOR_RHS_ZERO;
+		r.sweeps = (sweeps > 0) ? sweeps :
+		           (int) (1.E9 / ((double) r.N * r.N)) + 1;
+
+		for (it = 0; it < nthr; it++)
+		for (ik = 0; ik < nkern; ik++)
+		for (il = 0; il < nlay; il++)
+		for (ig = 0; ig < ngam; ig++) {
+			r.threads = (int) threads[it];
+			#ifdef _OPENMP
+			omp_set_num_threads(r.threads);
+			#else
+			r.threads = 1;
+			#endif
+			/* a kernel the CPU lacks is replaced by a narrower one */
+			r.kernel = selectSORKernels((SORKernel) kernels[ik])->id;
+			r.layout = (SORLayout) layouts[il];
+			r.gamma = (gammas[ig] > 0.) ? gammas[ig] : SORParamSin(r.N);
+
+			initSOROptions(&opts);
+			opts.kernel = r.kernel;
+			opts.layout = r.layout;
+			opts.stats = &stats;
+			opts.log = NULL;
+
+			fprintf(stderr, "N %d, threads %d, kernel %s, layout %d, "
+			        "gamma %.4f\n", r.N, r.threads,
+			        selectSORKernels(r.kernel)->name, r.layout,
+			        r.gamma);
+			/* throughput: no norm until the last sweep, prec = 0
+			 * never stops early */
+			initGrid(f, r.N);
+			opts.check.every = r.sweeps;
+			t = now();
+			PoissonSOR2DRHS(f, rhs, r.gamma, r.N, r.sweeps, 0., &opts);
+			r.time = now() - t;
+
+			/* time to convergence, with the default checks */
+			initGrid(f, r.N);
+			opts.check.every = 1;
+			t = now();
+			PoissonSOR2DRHS(f, rhs, r.gamma, r.N, tmax, prec, &opts);
+			r.conv_time = now() - t;
+			r.conv_sweeps = stats.sweeps;
+
+			printResult(out, &r, stream, json, first);
+			fflush(out);
+			first = 0;
+		}
+
+		free(f);
+		free(rhs);
+	}
+
+	if (json)
+		fprintf(out, "\n]}\n");
+	fclose(out);
+
+	return 0;
+}